@@ -39,4 +39,9 @@
 // This defaults to 4
 #define MQTT_REQ_MAX_IN_FLIGHT 5
 
+// A whole PUBLISH (header, topic and payload) has to fit the output ring at once, the
+// default 256 bytes is smaller than the status and link telemetry. Sized for the
+// largest message the publish queue accepts, see MQTT_QUEUE_PAYLOAD_LEN.
+#define MQTT_OUTPUT_RINGBUF_SIZE 1024
+
 #endif
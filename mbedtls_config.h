@@ -1,6 +1,18 @@
 #ifndef MBEDTLS_CONFIG_TLS_CLIENT_H
 #define MBEDTLS_CONFIG_TLS_CLIENT_H
 
+#ifdef SENSOR_HUB_LEAN_TLS
+#include "mbedtls_config_lean.h"
+#else
 #include "mbedtls_config_examples_common.h"
+#endif
 
-#endif
\ No newline at end of file
+// Client side of RFC 5077 tickets, lets a reconnect resume the previous session
+// instead of repeating the certificate exchange and ECDHE. Session ID resumption
+// needs no option and is used when the broker does not issue tickets.
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+// Allocations go through tls_heap.c so the handshake heap peak can be measured
+#define MBEDTLS_PLATFORM_MEMORY
+
+#endif
@@ -2,109 +2,163 @@
 #include "pico/time.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include "mqtt.h"
+#include "events.h"
+#include "sensor.h"
 
-void update_alarm_state(alarm_context_t *ctx, alarm_event_t event) {
-    alarm_context_t previous_state = *ctx;
-    switch (ctx->current_state) {
-        case ALARM_STATE_ARMED:
-            if (event == EVENT_TRIGGER) {
-                alarm_trigger(ctx);
-                ctx->current_state = ALARM_STATE_TRIGGERED;
-            }
-            else if (event == EVENT_DISARM) {
-                ctx->current_state = ALARM_STATE_DISARMED;
-            }
-            else if (event == EVENT_ENTRY_DELAY) {
-                ctx->current_state = ALARM_STATE_TRIGGERING;
-                ctx->enter_delay_active = true;
-                add_repeating_timer_ms(ENTRY_DELAY_MS, entry_delay_callback, ctx, &ctx->entry_timer);
-            }
-            break;
-        case ALARM_STATE_ARMING:
-            if(event == EVENT_ARM) {
-                ctx->current_state = ALARM_STATE_ARMED;
-            }
-            else if(event == EVENT_DISARM) {
-                bool cancelled = cancel_repeating_timer(&ctx->exit_timer);
-                if (cancelled) {
-                    ctx->exit_delay_active = false;
-                    printf("Exit delay cancelled\n");
-                }
-            }
-            else if(event == EVENT_EXIT_DELAY) {
-                printf("UHMMM... got exit delay (EVENT_EXIT_DELAY) while arming (EVENT_DISARM), this should not happen\n");
-            }
-        case ALARM_STATE_TRIGGERED:
-            if (event == EVENT_TIMEOUT) {
-                ctx->current_state = ALARM_STATE_ARMED;
-            }
-            else if (event == EVENT_DISARM) {
-                ctx->current_state = ALARM_STATE_DISARMED;
-            }
-            else if (event == EVENT_RESET) {
-                // maybe save last state before it got triggered?
-                // currently assume that it can only be triggered when armed
-                ctx->current_state = ALARM_STATE_ARMED;
-            }
-            else if (event == EVENT_EXIT_DELAY) {
-                // it does not make sense why you would want to delay the disarming from triggered state
-                // this is not intended, just in case somewhere I accidentally do, change state immediately
-                ctx->current_state = ALARM_STATE_DISARMED;
-            }
-            break;
-        case ALARM_STATE_TRIGGERING:
-            if (event == EVENT_TRIGGER) {
-                if (ctx->enter_delay_active) {
-                    // If entry delay is active, we need to cancel it
-                    cancel_repeating_timer(&ctx->entry_timer);
-                    ctx->enter_delay_active = false;
-                }
-                alarm_trigger(ctx);
-                ctx->current_state = ALARM_STATE_TRIGGERED;
-            }
-            else if (event == EVENT_DISARM) {
-                if (ctx->enter_delay_active) {
-                    // If entry delay is active, we need to cancel it
-                    cancel_repeating_timer(&ctx->entry_timer);
-                    ctx->enter_delay_active = false;
-                }
-                ctx->current_state = ALARM_STATE_DISARMED;
-            }
-            else if (event == EVENT_ENTRY_DELAY) {
-                ctx->current_state = ALARM_STATE_TRIGGERING;
-                ctx->enter_delay_active = true;
-                add_repeating_timer_ms(ENTRY_DELAY_MS, entry_delay_callback, ctx, &ctx->entry_timer);
-            }
-            else if (event == EVENT_RESET) {
-                // Resetting from triggering state goes to armed
-                if (ctx->enter_delay_active) {
-                    cancel_repeating_timer(&ctx->entry_timer);
-                    ctx->enter_delay_active = false;
-                }
-                ctx->current_state = ALARM_STATE_ARMED;
-            }
-            break;
-        case ALARM_STATE_DISARMED: // cannot go from disarmed -> triggered
-            if (event == EVENT_ARM) {
-                ctx->current_state = ALARM_STATE_ARMED;
-            }
-            else if(event == EVENT_EXIT_DELAY) {
-                ctx->current_state = ALARM_STATE_ARMING;
-                ctx->exit_delay_active = true;
-                add_repeating_timer_ms(EXIT_DELAY_MS, exit_delay_callback, ctx, &ctx->exit_timer);
-            }
-            break;
+bool alarm_post_event(alarm_event_t event) {
+    return events_push_shared(EVENT_RING_ALARM, HUB_EVENT_ALARM_INPUT, 0, 0, event);
+}
+
+// Expiries carry the generation of the timer that posted them in the pin field
+static bool post_expiry(alarm_event_t event, uint8_t generation) {
+    return events_push_shared(EVENT_RING_ALARM, HUB_EVENT_ALARM_INPUT, generation, 0, event);
+}
+
+// An expiry can be queued behind a DISARM that cancelled its timer too late. If a new
+// delay starts before the ring is drained, it must not end that delay early.
+static bool expiry_current(const alarm_context_t *ctx, const event_record_t *event) {
+    switch ((alarm_event_t)event->data) {
+        case EVENT_EXIT_DELAY_EXPIRED:
+            return ctx->exit_delay_active && event->pin == ctx->exit_timer_gen;
+        case EVENT_ENTRY_DELAY_EXPIRED:
+            return ctx->enter_delay_active && event->pin == ctx->entry_timer_gen;
         default:
-            break;
+            return true;
     }
+}
+
+void alarm_process_events(alarm_context_t *ctx) {
+    event_record_t event;
+    while (events_pop(EVENT_RING_ALARM, &event)) {
+        events_mark_record_handled(&event);
+        if (!expiry_current(ctx, &event)) {
+            printf("Dropped stale %s delay expiry\n",
+                   event.data == EVENT_EXIT_DELAY_EXPIRED ? "exit" : "entry");
+            continue;
+        }
+        update_alarm_state(ctx, (alarm_event_t)event.data);
+    }
+}
+
+static void start_exit_timer(alarm_context_t *ctx);
+static void cancel_exit_timer(alarm_context_t *ctx);
+static void start_entry_timer(alarm_context_t *ctx);
+static void cancel_entry_timer(alarm_context_t *ctx);
+
+// Both tables are const so they live in flash
+static const alarm_state_desc_t alarm_states[ALARM_STATE_COUNT] = {
+    [ALARM_STATE_ARMED] = {
+        .name = "ARMED",
+    },
+    [ALARM_STATE_ARMING] = {
+        .name = "ARMING",
+        .timer_start = start_exit_timer,
+        .timer_cancel = cancel_exit_timer,
+    },
+    [ALARM_STATE_DISARMED] = {
+        .name = "DISARMED",
+    },
+    [ALARM_STATE_TRIGGERED] = {
+        .name = "TRIGGERED",
+        .on_entry = alarm_trigger,
+    },
+    [ALARM_STATE_TRIGGERING] = {
+        .name = "TRIGGERING",
+        .timer_start = start_entry_timer,
+        .timer_cancel = cancel_entry_timer,
+    },
+};
+
+#define GOTO(state) { .valid = 1, .next_state = (state) }
+
+static const alarm_transition_t alarm_transitions[ALARM_STATE_COUNT][ALARM_EVENT_COUNT] = {
+    [ALARM_STATE_ARMED] = {
+        [EVENT_TRIGGER]             = GOTO(ALARM_STATE_TRIGGERED),
+        [EVENT_DISARM]              = GOTO(ALARM_STATE_DISARMED),
+        [EVENT_ENTRY_DELAY]         = GOTO(ALARM_STATE_TRIGGERING),
+    },
+    [ALARM_STATE_ARMING] = {
+        [EVENT_ARM]                 = GOTO(ALARM_STATE_ARMED),
+        [EVENT_DISARM]              = GOTO(ALARM_STATE_DISARMED),
+        [EVENT_EXIT_DELAY_EXPIRED]  = GOTO(ALARM_STATE_ARMED),
+    },
+    [ALARM_STATE_DISARMED] = { // cannot go from disarmed -> triggered
+        [EVENT_ARM]                 = GOTO(ALARM_STATE_ARMED),
+        [EVENT_EXIT_DELAY]          = GOTO(ALARM_STATE_ARMING),
+    },
+    [ALARM_STATE_TRIGGERED] = {
+        [EVENT_TIMEOUT]             = GOTO(ALARM_STATE_ARMED),
+        [EVENT_DISARM]              = GOTO(ALARM_STATE_DISARMED),
+        // currently assume that it can only be triggered when armed
+        [EVENT_RESET]               = GOTO(ALARM_STATE_ARMED),
+        // delaying the disarm from triggered makes no sense, change state immediately
+        [EVENT_EXIT_DELAY]          = GOTO(ALARM_STATE_DISARMED),
+    },
+    [ALARM_STATE_TRIGGERING] = {
+        [EVENT_TRIGGER]             = GOTO(ALARM_STATE_TRIGGERED),
+        [EVENT_ENTRY_DELAY_EXPIRED] = GOTO(ALARM_STATE_TRIGGERED),
+        [EVENT_DISARM]              = GOTO(ALARM_STATE_DISARMED),
+        [EVENT_RESET]               = GOTO(ALARM_STATE_ARMED),
+    },
+};
+
+#undef GOTO
+
+const alarm_transition_t* alarm_lookup_transition(alarm_state_t state, alarm_event_t event) {
+    if ((unsigned)state >= ALARM_STATE_COUNT || (unsigned)event >= ALARM_EVENT_COUNT) return NULL;
+
+    const alarm_transition_t *transition = &alarm_transitions[state][event];
+    return transition->valid ? transition : NULL;
+}
+
+void update_alarm_state(alarm_context_t *ctx, alarm_event_t event) {
+    const alarm_transition_t *transition = alarm_lookup_transition(ctx->current_state, event);
+    if (!transition) return;
+
+    alarm_state_t previous_state = ctx->current_state;
+    const alarm_state_desc_t *from = &alarm_states[previous_state];
+    const alarm_state_desc_t *to = &alarm_states[transition->next_state];
+
+    if (from->timer_cancel) from->timer_cancel(ctx);
+    if (from->on_exit) from->on_exit(ctx);
 
-    if(previous_state.current_state != ctx->current_state) {
+    ctx->current_state = (alarm_state_t)transition->next_state;
+
+    if (to->on_entry) to->on_entry(ctx);
+    if (to->timer_start) to->timer_start(ctx);
+
+    if(previous_state != ctx->current_state) {
         printf("Alarm state changed from %s to %s\n",
-               alarm_state_to_string(previous_state.current_state),
+               alarm_state_to_string(previous_state),
                alarm_state_to_string(ctx->current_state));
-        mqtt_flags.alarm_state_changed = true;
+        // Queued like a door change, so the transition keeps its time and order while MQTT is down
+        events_push(EVENT_RING_SENSOR, HUB_EVENT_ALARM_CHANGED, previous_state, ctx->current_state,
+                    sensor_index(ctx->triggered_sensor));
+    }
+}
+
+static void start_exit_timer(alarm_context_t *ctx) {
+    ctx->exit_timer_gen++;
+    ctx->exit_delay_active = add_repeating_timer_ms(EXIT_DELAY_MS, exit_delay_callback, ctx, &ctx->exit_timer);
+}
+
+static void cancel_exit_timer(alarm_context_t *ctx) {
+    if (ctx->exit_delay_active && cancel_repeating_timer(&ctx->exit_timer)) {
+        printf("Exit delay cancelled\n");
+    }
+    ctx->exit_delay_active = false;
+}
+
+static void start_entry_timer(alarm_context_t *ctx) {
+    ctx->entry_timer_gen++;
+    ctx->enter_delay_active = add_repeating_timer_ms(ENTRY_DELAY_MS, entry_delay_callback, ctx, &ctx->entry_timer);
+}
+
+static void cancel_entry_timer(alarm_context_t *ctx) {
+    if (ctx->enter_delay_active && cancel_repeating_timer(&ctx->entry_timer)) {
+        printf("Entry delay cancelled\n");
     }
+    ctx->enter_delay_active = false;
 }
 
 void alarm_trigger(alarm_context_t *ctx) {
@@ -126,32 +180,20 @@ alarm_context_t *alarm_init() {
 }
 
 const char* alarm_state_to_string(alarm_state_t state) {
-    switch (state) {
-        case ALARM_STATE_ARMED: return "ARMED";
-        case ALARM_STATE_DISARMED: return "DISARMED";
-        case ALARM_STATE_TRIGGERED: return "TRIGGERED";
-        case ALARM_STATE_TRIGGERING: return "TRIGGERING";
-        case ALARM_STATE_ARMING: return "ARMING";
-        default: return "UNKNOWN";
-    }
+    if ((unsigned)state >= ALARM_STATE_COUNT) return "UNKNOWN";
+    return alarm_states[state].name;
 }
 
+// Timer callbacks run in IRQ context: only queue the expiry, the main loop decides
+// whether it still applies (e.g. after a DISARM, or a newer delay of the same kind)
 bool exit_delay_callback(struct repeating_timer *rt) {
-    alarm_context_t *ctx = (alarm_context_t *) rt->user_data;
-    if(ctx->current_state == ALARM_STATE_ARMING) {
-        update_alarm_state(ctx, EVENT_ARM);
-        printf("Exit delay expired, system about to ARM\n");
-    }
-    ctx->exit_delay_active = false;
+    const alarm_context_t *ctx = rt->user_data;
+    post_expiry(EVENT_EXIT_DELAY_EXPIRED, ctx->exit_timer_gen);
     return false;
 }
 
 bool entry_delay_callback(struct repeating_timer *rt) {
-    alarm_context_t *ctx = (alarm_context_t *) rt->user_data;
-    if(ctx->current_state == ALARM_STATE_TRIGGERING) {
-        printf("Entry delay expired, system about to TRIGGER\n");
-        update_alarm_state(ctx, EVENT_TRIGGER);
-    }
-    ctx->enter_delay_active = false;
+    const alarm_context_t *ctx = rt->user_data;
+    post_expiry(EVENT_ENTRY_DELAY_EXPIRED, ctx->entry_timer_gen);
     return false;
-}
\ No newline at end of file
+}
@@ -16,9 +16,29 @@ typedef enum {
     EVENT_RESET,
     EVENT_TRIGGER,
     EVENT_EXIT_DELAY,
-    EVENT_ENTRY_DELAY
+    EVENT_ENTRY_DELAY,
+    EVENT_EXIT_DELAY_EXPIRED,   // posted by the exit delay timer only, tagged with its generation
+    EVENT_ENTRY_DELAY_EXPIRED,  // posted by the entry delay timer only, tagged with its generation
+    ALARM_EVENT_COUNT
 } alarm_event_t;
 
+typedef void (*alarm_action_t)(alarm_context_t *ctx);
+
+// Per-state hooks, run by update_alarm_state when the state is entered or left
+typedef struct {
+    const char *name;
+    alarm_action_t on_entry;        // after current_state has been updated
+    alarm_action_t on_exit;         // before current_state is updated
+    alarm_action_t timer_start;     // delay timer started on entry
+    alarm_action_t timer_cancel;    // delay timer cancelled on exit
+} alarm_state_desc_t;
+
+// One cell of the transition table, cells left out of the table are ignored events
+typedef struct {
+    uint8_t valid;
+    uint8_t next_state;             // alarm_state_t
+} alarm_transition_t;
+
 typedef struct {
     struct repeating_timer timer;
     bool active;
@@ -29,8 +49,19 @@ alarm_context_t* alarm_init(void);
 void alarm_trigger(alarm_context_t *ctx);
 void alarm_reset(alarm_context_t *ctx);
 
+// Queue an input for the alarm state machine. Safe from any context (GPIO IRQ,
+// timer callbacks, lwIP callbacks, main loop) and takes constant time.
+bool alarm_post_event(alarm_event_t event);
+
+// Main loop only: apply all queued inputs in the order they were posted
+void alarm_process_events(alarm_context_t *ctx);
+
+// Applies one transition. Only called by alarm_process_events, use alarm_post_event instead.
 void update_alarm_state(alarm_context_t *ctx, alarm_event_t event);
 
+// O(1) lookup into the const transition table, NULL if the event is ignored in that state
+const alarm_transition_t* alarm_lookup_transition(alarm_state_t state, alarm_event_t event);
+
 // Helper functions
 static inline bool alarm_is_armed(const alarm_context_t *ctx) {
     return ctx->current_state == ALARM_STATE_ARMED;
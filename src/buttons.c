@@ -4,6 +4,7 @@
 #include "pico/time.h"
 #include <stdio.h>
 #include "alarm.h"
+#include "events.h"
 
 static button_manager_t* g_button_manager = NULL;
 
@@ -34,46 +35,63 @@ void buttons_init(button_manager_t* manager, alarm_context_t* alarm_ctx) {
     sleep_ms(10);  // Allow GPIO to stabilize
     bool initial_switch_state = gpio_get(ARM_SWITCH_PIN);
     printf("Initial ARM switch position: %s\n", initial_switch_state ? "HIGH (ARM position)" : "LOW (DISARM position)");
-    update_alarm_state(g_button_manager->alarm_ctx, initial_switch_state ? EVENT_ARM : EVENT_DISARM);
+    alarm_post_event(initial_switch_state ? EVENT_ARM : EVENT_DISARM);
     // Optional: Sync alarm state with physical switch position at startup
     // Uncomment if you want the system to match the physical switch on boot
     /*
     if (initial_switch_state && manager->alarm_ctx->current_state == ALARM_STATE_DISARMED) {
-        update_alarm_state(manager->alarm_ctx, EVENT_ARM);
+        alarm_post_event(EVENT_ARM);
         printf("System synced to ARM position on startup\n");
     }
     */
 }
 
+// Runs in GPIO IRQ context: timestamp the edge and queue it for the main loop
 void button_gpio_callback(uint gpio, uint32_t events) {
-    if (!g_button_manager) return;
-    
-    uint32_t current_time = to_ms_since_boot(get_absolute_time());
-    
     switch (gpio) {
-        case ARM_SWITCH_PIN: {
-            // Check debounce
-            if (current_time - g_button_manager->arm_switch.last_press_time < BUTTON_DEBOUNCE_MS) {
+        case ARM_SWITCH_PIN:
+            events_push(EVENT_RING_GPIO, HUB_EVENT_ARM_SWITCH, gpio, gpio_get(gpio), events);
+            break;
+
+        case RESET_BUTTON_PIN:
+            events_push(EVENT_RING_GPIO, HUB_EVENT_RESET_BUTTON, gpio, gpio_get(gpio), events);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Runs in the main loop for button records popped from EVENT_RING_GPIO
+void buttons_handle_event(const event_record_t *event) {
+    if (!g_button_manager) return;
+
+    // Debounce against the edge timestamp, not the time the loop got around to it
+    uint32_t event_time = (uint32_t)(event->timestamp_us / 1000);
+
+    switch ((hub_event_t)event->type) {
+        case HUB_EVENT_ARM_SWITCH: {
+            if (event_time - g_button_manager->arm_switch.last_press_time < BUTTON_DEBOUNCE_MS) {
                 return;
             }
+            g_button_manager->arm_switch.last_press_time = event_time;
 
-            g_button_manager->arm_switch.last_press_time = current_time;
-            
-            // Read current switch state
-            bool switch_high = gpio_get(ARM_SWITCH_PIN);
+            // Switch position as sampled in the IRQ
+            bool switch_high = event->level;
+            g_button_manager->arm_switch.state = switch_high;
             printf("ARM switch toggled to: %s\n", switch_high ? "HIGH (3.33V - ARM)" : "LOW (0V - DISARM)");
 
             if (switch_high) {
                 // Switch to HIGH position (3.33V) = ARM
                 if (g_button_manager->alarm_ctx->current_state == ALARM_STATE_DISARMED) {
-                    update_alarm_state(g_button_manager->alarm_ctx, EVENT_EXIT_DELAY);
+                    alarm_post_event(EVENT_EXIT_DELAY);
                 } else {
                     printf("System already armed or in triggered state\n");
                 }
             } else {
                 // Switch to LOW position (0V) = DISARM
                 if (g_button_manager->alarm_ctx->current_state != ALARM_STATE_DISARMED) {
-                    update_alarm_state(g_button_manager->alarm_ctx, EVENT_DISARM);
+                    alarm_post_event(EVENT_DISARM);
                     printf("System DISARMED\n");
                 } else {
                     printf("System already disarmed\n");
@@ -82,18 +100,16 @@ void button_gpio_callback(uint gpio, uint32_t events) {
             break;
         }
 
-        case RESET_BUTTON_PIN: {
-            // Check debounce
-            if (current_time - g_button_manager->reset_button.last_press_time < BUTTON_DEBOUNCE_MS) {
+        case HUB_EVENT_RESET_BUTTON: {
+            if (event_time - g_button_manager->reset_button.last_press_time < BUTTON_DEBOUNCE_MS) {
                 return;
             }
-
-            g_button_manager->reset_button.last_press_time = current_time;
+            g_button_manager->reset_button.last_press_time = event_time;
             printf("RESET button pressed\n");
             
             // Can disarm from any state except already disarmed
             if (g_button_manager->alarm_ctx->current_state != ALARM_STATE_DISARMED) {
-                update_alarm_state(g_button_manager->alarm_ctx, EVENT_RESET);
+                alarm_post_event(EVENT_RESET);
             } else {
                 printf("System already disarmed\n");
             }
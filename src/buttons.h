@@ -5,6 +5,7 @@
 #include "pico/stdlib.h"
 #include <stdbool.h>
 #include "common.h"
+#include "events.h"
 
 // GPIO pin assignments for buttons
 #define ARM_SWITCH_PIN      3
@@ -27,5 +28,6 @@ typedef struct {
 // Function prototypes
 void buttons_init(button_manager_t* manager, alarm_context_t* alarm_ctx);
 void button_gpio_callback(uint gpio, uint32_t events);
+void buttons_handle_event(const event_record_t *event);
 
 #endif // BUTTONS_H
@@ -0,0 +1,49 @@
+#include "cbor.h"
+#include <string.h>
+
+// Index + 1 is the key on the wire, append only so older decoders keep working
+static const char *const key_table[] = {
+    "state",
+    "seq",
+    "timestamp",
+    "replayed",
+    "triggered_by",
+    "status",
+    "uptime_ms",
+    "alarm_state",
+    "wifi_connected",
+    "mqtt_connected",
+    "version",
+};
+
+size_t cbor_head(uint8_t *out, uint8_t major, uint32_t value) {
+    uint8_t type = (uint8_t)(major << 5);
+    if (value < 24) {
+        out[0] = type | (uint8_t)value;
+        return 1;
+    }
+    if (value <= UINT8_MAX) {
+        out[0] = type | 24;
+        out[1] = (uint8_t)value;
+        return 2;
+    }
+    if (value <= UINT16_MAX) {
+        out[0] = type | 25;
+        out[1] = (uint8_t)(value >> 8);
+        out[2] = (uint8_t)value;
+        return 3;
+    }
+    out[0] = type | 26;
+    out[1] = (uint8_t)(value >> 24);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 8);
+    out[4] = (uint8_t)value;
+    return 5;
+}
+
+uint8_t cbor_key_id(const char *key) {
+    for (size_t i = 0; i < sizeof(key_table) / sizeof(key_table[0]); i++) {
+        if (strcmp(key, key_table[i]) == 0) return (uint8_t)(i + 1);
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimal CBOR (RFC 8949) encoding used by the payload writer in json.c. Objects
+// become indefinite-length maps so they can be streamed without counting members,
+// and member names from the key table are sent as small integers.
+// tools/cbor_decode.py holds the same key table and must be kept in step.
+
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_NEGINT 1
+#define CBOR_MAJOR_TEXT 3
+
+#define CBOR_MAP_BEGIN 0xBF     // indefinite-length map
+#define CBOR_BREAK 0xFF
+#define CBOR_FALSE 0xF4
+#define CBOR_TRUE 0xF5
+
+#define CBOR_HEAD_MAX 5         // largest head for a 32-bit argument
+
+// Writes the initial byte and argument of an item, returns its length
+size_t cbor_head(uint8_t *out, uint8_t major, uint32_t value);
+
+// Integer key for a member name, 0 if it is not in the table (then sent as text)
+uint8_t cbor_key_id(const char *key);
+
+#endif // CBOR_H
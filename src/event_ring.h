@@ -0,0 +1,87 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fixed-size, allocation-free single-producer/single-consumer ring of event records.
+// Lock-free: the producer only writes head, the consumer only writes tail. Each ring
+// must have exactly one producer context (one IRQ, or the main loop) and one consumer.
+// No pico-sdk dependencies so it can be compiled and stress tested on the host.
+
+#define EVENT_RING_SIZE 64  // must be a power of two
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+
+_Static_assert((EVENT_RING_SIZE & EVENT_RING_MASK) == 0, "EVENT_RING_SIZE must be a power of two");
+
+typedef struct {
+    uint64_t timestamp_us;  // time_us_64() when the producer saw the event
+    uint32_t data;          // event specific payload (sensor index, command sequence, ...)
+    uint8_t type;           // hub_event_t
+    uint8_t pin;            // Pico GPIO or MCP23018 pin number
+    uint8_t level;          // pin level at timestamp_us
+    uint8_t reserved;
+} event_record_t;
+
+typedef struct {
+    uint32_t head;              // free-running write index, producer only
+    uint32_t tail;              // free-running read index, consumer only
+    uint32_t overflow_count;    // pushes rejected because the ring was full, producer only
+    uint32_t high_water;        // deepest fill level seen, producer only
+    event_record_t slots[EVENT_RING_SIZE];
+} event_ring_t;
+
+static inline void event_ring_init(event_ring_t *ring) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overflow_count = 0;
+    ring->high_water = 0;
+}
+
+static inline uint32_t event_ring_count(const event_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+static inline bool event_ring_is_empty(const event_ring_t *ring) {
+    return event_ring_count(ring) == 0;
+}
+
+// Producer side. Returns false (and counts an overflow) if the ring is full.
+static inline bool event_ring_push(event_ring_t *ring, const event_record_t *event) {
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t used = head - tail;
+
+    if (used >= EVENT_RING_SIZE) {
+        ring->overflow_count++;
+        return false;
+    }
+
+    ring->slots[head & EVENT_RING_MASK] = *event;
+    // Publish the slot contents before the new head becomes visible
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    if (used + 1 > ring->high_water) {
+        ring->high_water = used + 1;
+    }
+    return true;
+}
+
+// Consumer side. Returns false if the ring is empty.
+static inline bool event_ring_pop(event_ring_t *ring, event_record_t *event) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *event = ring->slots[tail & EVENT_RING_MASK];
+    // Release the slot back to the producer only after it has been copied out
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#endif // EVENT_RING_H
@@ -0,0 +1,185 @@
+#include "events.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+static volatile uint32_t pending_events = 0;
+static volatile uint64_t posted_at_us[HUB_EVENT_COUNT];
+
+// Consumer-side copy of the post timestamps, taken together with the pending mask
+static uint64_t dispatch_posted_at_us[HUB_EVENT_COUNT];
+static event_latency_t latency[HUB_EVENT_COUNT];
+
+static event_ring_t rings[EVENT_RING_COUNT];
+
+static void record_latency(hub_event_t event, uint64_t posted_at) {
+    uint64_t elapsed = time_us_64() - posted_at;
+    uint32_t elapsed_us = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+
+    event_latency_t *stats = &latency[event];
+    if (stats->count == 0 || elapsed_us < stats->min_us) stats->min_us = elapsed_us;
+    if (elapsed_us > stats->max_us) stats->max_us = elapsed_us;
+    stats->total_us += elapsed_us;
+    stats->count++;
+}
+
+void events_init(void) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    pending_events = 0;
+    restore_interrupts(irq_state);
+    for (int i = 0; i < EVENT_RING_COUNT; i++) {
+        event_ring_init(&rings[i]);
+    }
+    events_reset_latency();
+}
+
+void events_post(hub_event_t event) {
+    if (event >= HUB_EVENT_COUNT) return;
+
+    uint32_t bit = HUB_EVENT_BIT(event);
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (!(pending_events & bit)) {
+        // Only the first post is timestamped, coalesced posts are handled together
+        posted_at_us[event] = time_us_64();
+        pending_events |= bit;
+    }
+    restore_interrupts(irq_state);
+
+    // Wake the main loop if it is sitting in __wfe()
+    __sev();
+}
+
+bool events_push(event_ring_id_t ring, hub_event_t type, uint8_t pin, uint8_t level, uint32_t data) {
+    if (ring >= EVENT_RING_COUNT) return false;
+
+    event_record_t event = {
+        .timestamp_us = time_us_64(),
+        .data = data,
+        .type = (uint8_t)type,
+        .pin = pin,
+        .level = level,
+    };
+    bool queued = event_ring_push(&rings[ring], &event);
+
+    // Post even on overflow so the consumer drains the ring as soon as possible
+    events_post(type);
+    return queued;
+}
+
+bool events_push_shared(event_ring_id_t ring, hub_event_t type, uint8_t pin, uint8_t level, uint32_t data) {
+    if (ring >= EVENT_RING_COUNT) return false;
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    event_record_t event = {
+        .timestamp_us = time_us_64(),
+        .data = data,
+        .type = (uint8_t)type,
+        .pin = pin,
+        .level = level,
+    };
+    bool queued = event_ring_push(&rings[ring], &event);
+    restore_interrupts(irq_state);
+
+    events_post(type);
+    return queued;
+}
+
+bool events_pop(event_ring_id_t ring, event_record_t *event) {
+    if (ring >= EVENT_RING_COUNT) return false;
+    return event_ring_pop(&rings[ring], event);
+}
+
+uint32_t events_ring_overflows(event_ring_id_t ring) {
+    if (ring >= EVENT_RING_COUNT) return 0;
+    return __atomic_load_n(&rings[ring].overflow_count, __ATOMIC_RELAXED);
+}
+
+uint32_t events_wait(uint32_t poll_ms) {
+    uint32_t events;
+
+    while (true) {
+        uint32_t irq_state = save_and_disable_interrupts();
+        events = pending_events;
+        pending_events = 0;
+        for (int i = 0; i < HUB_EVENT_COUNT; i++) {
+            if (events & HUB_EVENT_BIT(i)) {
+                dispatch_posted_at_us[i] = posted_at_us[i];
+            }
+        }
+        restore_interrupts(irq_state);
+
+        if (events) return events;
+
+        if (poll_ms) {
+            sleep_ms(poll_ms);
+        } else {
+            // A post between the check above and here sets the event register,
+            // so __wfe() returns immediately instead of missing the wakeup
+            __wfe();
+        }
+    }
+}
+
+void events_mark_handled(hub_event_t event) {
+    if (event >= HUB_EVENT_COUNT) return;
+    record_latency(event, dispatch_posted_at_us[event]);
+}
+
+void events_mark_record_handled(const event_record_t *event) {
+    if (event->type >= HUB_EVENT_COUNT) return;
+    record_latency((hub_event_t)event->type, event->timestamp_us);
+}
+
+const event_latency_t* events_get_latency(hub_event_t event) {
+    if (event >= HUB_EVENT_COUNT) return NULL;
+    return &latency[event];
+}
+
+void events_print_latency(void) {
+    printf("Event latency (post -> handler):\n");
+    for (int i = 0; i < HUB_EVENT_COUNT; i++) {
+        const event_latency_t *stats = &latency[i];
+        if (stats->count == 0) continue;
+        printf("  %-16s n=%lu min=%luus avg=%luus max=%luus\n",
+               events_to_string((hub_event_t)i),
+               stats->count,
+               stats->min_us,
+               (uint32_t)(stats->total_us / stats->count),
+               stats->max_us);
+    }
+    for (int i = 0; i < EVENT_RING_COUNT; i++) {
+        printf("  ring %d: depth %lu, high water %lu/%d, overflows %lu\n",
+               i,
+               event_ring_count(&rings[i]),
+               rings[i].high_water,
+               EVENT_RING_SIZE,
+               events_ring_overflows((event_ring_id_t)i));
+    }
+}
+
+void events_reset_latency(void) {
+    memset(latency, 0, sizeof(latency));
+}
+
+const char* events_to_string(hub_event_t event) {
+    switch (event) {
+        case HUB_EVENT_MCP_INTERRUPT: return "MCP_INTERRUPT";
+        case HUB_EVENT_ARM_SWITCH: return "ARM_SWITCH";
+        case HUB_EVENT_RESET_BUTTON: return "RESET_BUTTON";
+        case HUB_EVENT_ALARM_CHANGED: return "ALARM_CHANGED";
+        case HUB_EVENT_MQTT_CONNECTION: return "MQTT_CONNECTION";
+        case HUB_EVENT_MQTT_COMMAND: return "MQTT_COMMAND";
+        case HUB_EVENT_TICK: return "TICK";
+        case HUB_EVENT_SENSOR_CHANGED: return "SENSOR_CHANGED";
+        case HUB_EVENT_ALARM_INPUT: return "ALARM_INPUT";
+        case HUB_EVENT_MCP_CAPTURE: return "MCP_CAPTURE";
+        case HUB_EVENT_DEBOUNCE_DUE: return "DEBOUNCE_DUE";
+        case HUB_EVENT_MCP_RESAMPLE: return "MCP_RESAMPLE";
+        case HUB_EVENT_DNS_RESULT: return "DNS_RESULT";
+        case HUB_EVENT_MQTT_PUBLISHED: return "MQTT_PUBLISHED";
+        case HUB_EVENT_JOURNAL_REPLAY: return "JOURNAL_REPLAY";
+        default: return "UNKNOWN";
+    }
+}
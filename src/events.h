@@ -0,0 +1,85 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "event_ring.h"
+
+// Typed events posted by ISRs, repeating timers and lwIP callbacks.
+// The main loop sleeps with __wfe() until at least one is pending.
+typedef enum {
+    HUB_EVENT_MCP_INTERRUPT,    // MCP23018 INTA asserted
+    HUB_EVENT_ARM_SWITCH,       // ARM switch edge
+    HUB_EVENT_RESET_BUTTON,     // RESET button press
+    HUB_EVENT_ALARM_CHANGED,    // alarm state machine changed state
+    HUB_EVENT_MQTT_CONNECTION,  // MQTT connected / disconnected
+    HUB_EVENT_MQTT_COMMAND,     // command received on the cmd topic
+    HUB_EVENT_TICK,             // housekeeping tick (status, heartbeat, reconnect)
+    HUB_EVENT_SENSOR_CHANGED,   // a sensor changed state (data = sensor index)
+    HUB_EVENT_ALARM_INPUT,      // input for the alarm state machine (data = alarm_event_t, pin = timer generation)
+    HUB_EVENT_MCP_CAPTURE,      // async MCP23018 interrupt capture read finished (data = result)
+    HUB_EVENT_DEBOUNCE_DUE,     // a debounce window ended, re-sample the expander (pin = expander)
+    HUB_EVENT_MCP_RESAMPLE,     // async MCP23018 GPIO re-sample finished (data = result)
+    HUB_EVENT_DNS_RESULT,       // MQTT server lookup finished (level = 1 if resolved)
+    HUB_EVENT_MQTT_PUBLISHED,   // an in-flight publish completed, queued messages can go out
+    HUB_EVENT_JOURNAL_REPLAY,   // replay interval elapsed, the next journaled event can go out
+    HUB_EVENT_COUNT
+} hub_event_t;
+
+// One SPSC ring per producer context, so no edge is lost between loop iterations
+typedef enum {
+    EVENT_RING_GPIO,        // producer: GPIO IRQ (MCP23018 INTA, buttons); consumer: main loop
+    EVENT_RING_NETWORK,     // producer: lwIP callbacks (mqtt.c); consumer: main loop
+    EVENT_RING_SENSOR,      // producers: sensor.c and alarm.c, both in the main loop; consumer: mqtt.c publishing
+    EVENT_RING_ALARM,       // producers: any context via events_push_shared(); consumer: alarm.c in the main loop
+    EVENT_RING_I2C,         // producer: I2C IRQ completion callbacks; consumer: main loop
+    EVENT_RING_TIMER,       // producer: hardware alarm callbacks (timer IRQ); consumer: main loop
+    EVENT_RING_COUNT
+} event_ring_id_t;
+
+#define HUB_EVENT_BIT(event) (1u << (event))
+
+// Housekeeping tick period, everything time based in the main loop runs off this
+#define HUB_TICK_INTERVAL_MS 1000
+
+// Post-to-dispatch latency statistics for one event type
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} event_latency_t;
+
+void events_init(void);
+
+// Safe to call from any IRQ or timer callback
+void events_post(hub_event_t event);
+
+// Timestamp an event and queue it on a ring, then wake the main loop.
+// Must only be called from the ring's single producer context.
+bool events_push(event_ring_id_t ring, hub_event_t type, uint8_t pin, uint8_t level, uint32_t data);
+
+// Same as events_push() for rings with several producer contexts. The push itself
+// runs with interrupts disabled for a few dozen cycles, the consumer stays lock-free.
+bool events_push_shared(event_ring_id_t ring, hub_event_t type, uint8_t pin, uint8_t level, uint32_t data);
+
+// Consumer side of a ring, returns false once the ring is empty
+bool events_pop(event_ring_id_t ring, event_record_t *event);
+uint32_t events_ring_overflows(event_ring_id_t ring);
+
+// Blocks (sleeping with __wfe) until at least one event is pending, then returns
+// and clears the pending mask. With poll_ms > 0 it instead sleeps a fixed period
+// like the old polling loop, which is useful for latency comparisons.
+uint32_t events_wait(uint32_t poll_ms);
+
+// Call when the handler for an event returned by events_wait() starts running
+void events_mark_handled(hub_event_t event);
+// Same for an event popped from a ring, measured from the record's own timestamp
+void events_mark_record_handled(const event_record_t *event);
+
+const event_latency_t* events_get_latency(hub_event_t event);
+void events_print_latency(void);
+void events_reset_latency(void);
+const char* events_to_string(hub_event_t event);
+
+#endif // EVENTS_H
@@ -0,0 +1,317 @@
+#include "i2c_async.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#define I2C_ASYNC_INTR_MASK_BASE (I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS)
+#define I2C_ASYNC_ABORT_GRACE_US 1000   // time for the controller to finish an abort
+
+typedef struct {
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t len;
+    bool read;
+    uint8_t *rx;
+    uint8_t tx[I2C_ASYNC_MAX_WRITE];
+    i2c_async_cb_t cb;
+    void *user_data;
+} i2c_async_txn_t;
+
+static i2c_inst_t *bus = NULL;
+
+// Queue of pending transactions, the active one stays at queue_tail until it completes.
+// Only modified with interrupts disabled or from the I2C IRQ.
+static i2c_async_txn_t queue[I2C_ASYNC_QUEUE_LEN];
+static uint8_t queue_tail = 0;
+static uint8_t queue_count = 0;
+
+// Active transaction state
+static i2c_async_txn_t *active = NULL;
+static uint8_t cmd_index;           // commands written to the TX FIFO (register byte + payload)
+static uint8_t rx_index;            // bytes read back so far
+static bool aborted;
+static bool abort_requested;
+static bool timed_out;
+static alarm_id_t timeout_alarm;
+static uint64_t started_at_us;
+// Result decided outside the I2C IRQ (timer, submit), completed by pending the IRQ
+static bool deferred;
+static int deferred_result;
+
+static i2c_async_stats_t stats;
+
+static void start_next(void);
+
+static inline uint8_t total_commands(const i2c_async_txn_t *txn) {
+    return 1 + txn->len;
+}
+
+static void fill_tx_fifo(i2c_hw_t *hw) {
+    uint8_t total = total_commands(active);
+
+    while (cmd_index < total && i2c_get_write_available(bus)) {
+        uint32_t cmd;
+        if (cmd_index == 0) {
+            cmd = active->reg;
+        } else if (active->read) {
+            // Repeated START before the first read, then one read command per byte
+            cmd = I2C_IC_DATA_CMD_CMD_BITS | (cmd_index == 1 ? I2C_IC_DATA_CMD_RESTART_BITS : 0);
+        } else {
+            cmd = active->tx[cmd_index - 1];
+        }
+
+        if (cmd_index == total - 1) {
+            cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+        hw->data_cmd = cmd;
+        cmd_index++;
+    }
+}
+
+static void drain_rx_fifo(i2c_hw_t *hw) {
+    while (hw->rxflr) {
+        uint8_t byte = (uint8_t)hw->data_cmd;
+        if (active->read && rx_index < active->len) {
+            active->rx[rx_index++] = byte;
+        }
+    }
+}
+
+static void finish(int result) {
+    i2c_hw_t *hw = i2c_get_hw(bus);
+    hw->intr_mask = 0;
+    if (timeout_alarm > 0) cancel_alarm(timeout_alarm);
+
+    uint32_t duration_us = (uint32_t)(time_us_64() - started_at_us);
+    if (duration_us > stats.max_duration_us) stats.max_duration_us = duration_us;
+    if (result < 0) {
+        stats.failed++;
+        if (result == PICO_ERROR_TIMEOUT) stats.timeouts++;
+    } else {
+        stats.completed++;
+    }
+
+    // Release the slot before the callback so it can queue a follow-up transaction
+    i2c_async_cb_t cb = active->cb;
+    void *user_data = active->user_data;
+    active = NULL;
+    queue_tail = (queue_tail + 1) % I2C_ASYNC_QUEUE_LEN;
+    queue_count--;
+
+    start_next();
+
+    if (cb) cb(result, user_data);
+}
+
+// Callbacks only ever run in the I2C IRQ, so their event ring keeps a single producer.
+// Called with interrupts disabled.
+static void finish_in_irq(int result) {
+    i2c_get_hw(bus)->intr_mask = 0;
+    deferred = true;
+    deferred_result = result;
+    irq_set_pending(I2C0_IRQ + i2c_get_index(bus));
+}
+
+static int64_t timeout_callback(alarm_id_t id, void *user_data) {
+    int64_t reschedule_us = 0;
+    uint32_t irq_state = save_and_disable_interrupts();
+
+    if (active && id == timeout_alarm) {
+        i2c_hw_t *hw = i2c_get_hw(bus);
+        timed_out = true;
+        if (!abort_requested) {
+            // Ask the controller to abort, it then raises TX_ABRT and STOP_DET
+            abort_requested = true;
+            hw->enable |= I2C_IC_ENABLE_ABORT_BITS;
+            reschedule_us = I2C_ASYNC_ABORT_GRACE_US;
+        } else {
+            // The abort did not complete either (SCL held low), give up on the controller
+            hw->enable = 0;
+            finish_in_irq(PICO_ERROR_TIMEOUT);
+        }
+    }
+
+    restore_interrupts(irq_state);
+    return reschedule_us;
+}
+
+static void i2c_async_irq_handler(void) {
+    i2c_hw_t *hw = i2c_get_hw(bus);
+    uint32_t status = hw->intr_stat;
+
+    if (!active) {
+        hw->intr_mask = 0;
+        (void)hw->clr_intr;
+        return;
+    }
+
+    if (deferred) {
+        deferred = false;
+        finish(deferred_result);
+        return;
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // NACK or arbitration loss, the controller flushes the TX FIFO and sends STOP
+        (void)hw->clr_tx_abrt;
+        aborted = true;
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
+        drain_rx_fifo(hw);
+    }
+
+    if ((status & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS) && !aborted) {
+        fill_tx_fifo(hw);
+        if (cmd_index >= total_commands(active)) {
+            hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+        }
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        drain_rx_fifo(hw);
+
+        int result;
+        if (aborted) {
+            result = timed_out ? PICO_ERROR_TIMEOUT : PICO_ERROR_GENERIC;
+        } else if (active->read && rx_index != active->len) {
+            result = PICO_ERROR_GENERIC;
+        } else {
+            result = active->len;
+        }
+        finish(result);
+    }
+}
+
+// Called with interrupts disabled or from the I2C IRQ
+static void start_next(void) {
+    if (active || queue_count == 0) return;
+
+    active = &queue[queue_tail];
+    cmd_index = 0;
+    rx_index = 0;
+    aborted = false;
+    abort_requested = false;
+    timed_out = false;
+    started_at_us = time_us_64();
+
+    // Without the timeout nothing guarantees a completion, so the transfer is not started
+    timeout_alarm = add_alarm_in_us(I2C_ASYNC_TIMEOUT_US, timeout_callback, NULL, true);
+    if (timeout_alarm <= 0) {
+        finish_in_irq(PICO_ERROR_INSUFFICIENT_RESOURCES);
+        return;
+    }
+
+    i2c_hw_t *hw = i2c_get_hw(bus);
+    // Target address can only be changed while the controller is disabled
+    hw->enable = 0;
+    hw->tar = active->addr;
+    hw->enable = 1;
+    hw->rx_tl = 0;  // RX_FULL as soon as one byte is available
+    hw->tx_tl = 0;  // TX_EMPTY once the FIFO has drained
+    (void)hw->clr_intr;
+
+    fill_tx_fifo(hw);
+
+    uint32_t mask = I2C_ASYNC_INTR_MASK_BASE;
+    if (active->read) mask |= I2C_IC_INTR_MASK_M_RX_FULL_BITS;
+    if (cmd_index < total_commands(active)) mask |= I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    hw->intr_mask = mask;
+}
+
+static bool submit(uint8_t addr, uint8_t reg, bool read, uint8_t *rx, const uint8_t *tx, uint8_t len,
+                   i2c_async_cb_t cb, void *user_data) {
+    if (!bus) return false;
+    if (read && (len == 0 || !rx)) return false;
+    if (!read && len > I2C_ASYNC_MAX_WRITE) return false;
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (queue_count >= I2C_ASYNC_QUEUE_LEN) {
+        stats.queue_full++;
+        restore_interrupts(irq_state);
+        return false;
+    }
+
+    i2c_async_txn_t *txn = &queue[(queue_tail + queue_count) % I2C_ASYNC_QUEUE_LEN];
+    txn->addr = addr;
+    txn->reg = reg;
+    txn->len = len;
+    txn->read = read;
+    txn->rx = rx;
+    if (!read && len) {
+        memcpy(txn->tx, tx, len);
+    }
+    txn->cb = cb;
+    txn->user_data = user_data;
+    queue_count++;
+    stats.submitted++;
+
+    start_next();
+    restore_interrupts(irq_state);
+    return true;
+}
+
+void i2c_async_init(i2c_inst_t *i2c) {
+    bus = i2c;
+    i2c_get_hw(i2c)->intr_mask = 0;
+
+    uint irq = I2C0_IRQ + i2c_get_index(i2c);
+    irq_set_exclusive_handler(irq, i2c_async_irq_handler);
+    irq_set_enabled(irq, true);
+}
+
+bool i2c_async_read(uint8_t addr, uint8_t reg, uint8_t *dst, uint8_t len, i2c_async_cb_t cb, void *user_data) {
+    return submit(addr, reg, true, dst, NULL, len, cb, user_data);
+}
+
+bool i2c_async_write(uint8_t addr, uint8_t reg, const uint8_t *src, uint8_t len, i2c_async_cb_t cb, void *user_data) {
+    return submit(addr, reg, false, NULL, src, len, cb, user_data);
+}
+
+typedef struct {
+    volatile bool done;
+    volatile int result;
+} blocking_wait_t;
+
+static void blocking_done(int result, void *user_data) {
+    blocking_wait_t *wait = (blocking_wait_t *)user_data;
+    wait->result = result;
+    wait->done = true;
+    __sev();
+}
+
+int i2c_async_read_blocking(uint8_t addr, uint8_t reg, uint8_t *dst, uint8_t len) {
+    blocking_wait_t wait = { .done = false, .result = PICO_ERROR_GENERIC };
+    if (!i2c_async_read(addr, reg, dst, len, blocking_done, &wait)) {
+        return PICO_ERROR_GENERIC;
+    }
+    // Completes or times out after I2C_ASYNC_TIMEOUT_US
+    while (!wait.done) {
+        __wfe();
+    }
+    return wait.result;
+}
+
+int i2c_async_write_blocking(uint8_t addr, uint8_t reg, const uint8_t *src, uint8_t len) {
+    blocking_wait_t wait = { .done = false, .result = PICO_ERROR_GENERIC };
+    if (!i2c_async_write(addr, reg, src, len, blocking_done, &wait)) {
+        return PICO_ERROR_GENERIC;
+    }
+    while (!wait.done) {
+        __wfe();
+    }
+    return wait.result;
+}
+
+bool i2c_async_busy(void) {
+    return queue_count != 0;
+}
+
+const i2c_async_stats_t* i2c_async_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,43 @@
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/i2c.h"
+
+// Interrupt-driven I2C register transaction engine.
+// Transactions are queued and run one after another from the I2C IRQ, so the CPU
+// is free while bytes are on the wire. Completion callbacks always run in the I2C IRQ,
+// timeouts included, and should only copy results / post events.
+
+#define I2C_ASYNC_QUEUE_LEN 8
+#define I2C_ASYNC_MAX_WRITE 24      // payload bytes per write transaction
+#define I2C_ASYNC_TIMEOUT_US 5000   // per transaction, then the transfer is aborted
+
+// result: number of payload bytes transferred, or a PICO_ERROR_* code
+typedef void (*i2c_async_cb_t)(int result, void *user_data);
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t failed;
+    uint32_t timeouts;
+    uint32_t queue_full;
+    uint32_t max_duration_us;
+} i2c_async_stats_t;
+
+void i2c_async_init(i2c_inst_t *i2c);
+
+// Queue a register read / write. Returns false if the queue is full.
+bool i2c_async_read(uint8_t addr, uint8_t reg, uint8_t *dst, uint8_t len, i2c_async_cb_t cb, void *user_data);
+bool i2c_async_write(uint8_t addr, uint8_t reg, const uint8_t *src, uint8_t len, i2c_async_cb_t cb, void *user_data);
+
+// Blocking helpers built on the queue, for boot-time configuration. Sleep with
+// __wfe() while the transfer runs. Never call from IRQ context.
+int i2c_async_read_blocking(uint8_t addr, uint8_t reg, uint8_t *dst, uint8_t len);
+int i2c_async_write_blocking(uint8_t addr, uint8_t reg, const uint8_t *src, uint8_t len);
+
+bool i2c_async_busy(void);
+const i2c_async_stats_t* i2c_async_get_stats(void);
+
+#endif // I2C_ASYNC_H
@@ -0,0 +1,135 @@
+#include "i2c_clock.h"
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/sync.h"
+#include "main.h"
+#include "i2c_async.h"
+
+// Candidates in ascending order, the first one is the conservative boot rate
+static i2c_clock_rate_result_t rates[] = {
+    { .khz = I2C_BUS_FREQUENCY_khz },
+    { .khz = 100 },
+    { .khz = 400 },
+    { .khz = 1000 },
+};
+
+#define RATE_COUNT (sizeof(rates) / sizeof(rates[0]))
+
+// Alternating bits and all-same bytes on both scratch bytes
+static const uint8_t test_patterns[][2] = {
+    { 0x55, 0xAA },
+    { 0xAA, 0x55 },
+    { 0x00, 0xFF },
+    { 0xFF, 0x00 },
+    { 0x5A, 0xA5 },
+    { 0x0F, 0xF0 },
+};
+
+static uint8_t current_rate = 0;
+static i2c_clock_stats_t stats = { .selected_khz = I2C_BUS_FREQUENCY_khz };
+
+static void apply_rate(uint8_t index) {
+    rates[index].actual_hz = i2c_set_baudrate(I2C_INSTANCE, rates[index].khz * 1000);
+    current_rate = index;
+    stats.selected_khz = rates[index].khz;
+}
+
+static uint32_t test_device(i2c_clock_rate_result_t *rate, uint8_t addr, uint8_t scratch_reg) {
+    uint32_t errors = 0;
+    for (int round = 0; round < I2C_CLOCK_TEST_ROUNDS; round++) {
+        for (size_t p = 0; p < sizeof(test_patterns) / sizeof(test_patterns[0]); p++) {
+            uint8_t readback[2] = { 0 };
+            rate->transfers += 2;
+            if (i2c_async_write_blocking(addr, scratch_reg, test_patterns[p], 2) != 2 ||
+                i2c_async_read_blocking(addr, scratch_reg, readback, 2) != 2 ||
+                readback[0] != test_patterns[p][0] || readback[1] != test_patterns[p][1]) {
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+uint32_t i2c_clock_negotiate(const uint8_t *addrs, uint8_t count, uint8_t scratch_reg) {
+    uint8_t best = 0;
+    stats.first_failing_khz = 0;
+
+    for (uint8_t r = 0; r < RATE_COUNT && rates[r].khz <= I2C_CLOCK_MAX_khz; r++) {
+        i2c_clock_rate_result_t *rate = &rates[r];
+        apply_rate(r);
+        rate->tested = true;
+        rate->transfers = 0;
+        rate->errors = 0;
+        for (uint8_t d = 0; d < count; d++) {
+            rate->errors += test_device(rate, addrs[d], scratch_reg);
+        }
+
+        printf("I2C self-test at %lu kHz (%lu Hz): %lu/%lu errors\n",
+               rate->khz, rate->actual_hz, rate->errors, rate->transfers);
+        if (rate->errors) {
+            stats.first_failing_khz = rate->khz;
+            break;
+        }
+        best = r;
+    }
+
+    apply_rate(best);
+    // Leave the scratch register as the configuration expects it
+    static const uint8_t zero[2] = { 0, 0 };
+    for (uint8_t d = 0; d < count; d++) {
+        i2c_async_write_blocking(addrs[d], scratch_reg, zero, sizeof(zero));
+    }
+
+    const i2c_async_stats_t *engine = i2c_async_get_stats();
+    stats.window_submitted = engine->submitted;
+    stats.window_failed = engine->failed;
+
+    i2c_clock_print_stats();
+    return stats.selected_khz;
+}
+
+uint32_t i2c_clock_get_khz(void) {
+    return stats.selected_khz;
+}
+
+bool i2c_clock_monitor(void) {
+    const i2c_async_stats_t *engine = i2c_async_get_stats();
+    uint32_t submitted = engine->submitted - stats.window_submitted;
+    uint32_t failed = engine->failed - stats.window_failed;
+    if (submitted < I2C_CLOCK_WINDOW_TRANSFERS) return false;
+
+    stats.window_submitted = engine->submitted;
+    stats.window_failed = engine->failed;
+    if (failed * 100 <= submitted * I2C_CLOCK_MAX_ERROR_PERCENT || current_rate == 0) {
+        return false;
+    }
+
+    // Every transfer is queued from the main loop, so an idle engine stays idle
+    // while the divider is reprogrammed
+    if (i2c_async_busy()) return false;
+
+    uint32_t old_khz = rates[current_rate].khz;
+    apply_rate(current_rate - 1);
+    stats.fallbacks++;
+    printf("I2C: %lu/%lu transfers failed, clock lowered from %lu to %lu kHz\n",
+           failed, submitted, old_khz, stats.selected_khz);
+    return true;
+}
+
+const i2c_clock_stats_t* i2c_clock_get_stats(void) {
+    return &stats;
+}
+
+void i2c_clock_print_stats(void) {
+    if (stats.first_failing_khz) {
+        printf("I2C clock: %lu kHz, first failing rate %lu kHz (margin x%lu.%lu), %lu fallbacks\n",
+               stats.selected_khz, stats.first_failing_khz,
+               stats.first_failing_khz / stats.selected_khz,
+               (stats.first_failing_khz * 10 / stats.selected_khz) % 10,
+               stats.fallbacks);
+    } else {
+        printf("I2C clock: %lu kHz, every tested rate passed, %lu fallbacks\n",
+               stats.selected_khz, stats.fallbacks);
+    }
+}
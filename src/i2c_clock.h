@@ -0,0 +1,46 @@
+#ifndef I2C_CLOCK_H
+#define I2C_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// I2C clock negotiation. At boot the bus is stepped up through the candidate
+// rates and every device gets write/read-back patterns on a scratch register.
+// The fastest rate without a single error is kept. At runtime the error rate of
+// the async engine is watched and the clock steps down if it rises.
+
+#define I2C_CLOCK_TEST_ROUNDS 8             // pattern sets per rate and device
+#define I2C_CLOCK_WINDOW_TRANSFERS 100      // runtime error rate is judged per window
+#define I2C_CLOCK_MAX_ERROR_PERCENT 5       // above this the clock steps down
+
+typedef struct {
+    uint32_t khz;
+    uint32_t actual_hz;         // what the divider actually produces
+    uint32_t transfers;
+    uint32_t errors;            // NACK/timeouts and read-back mismatches
+    bool tested;
+} i2c_clock_rate_result_t;
+
+typedef struct {
+    uint32_t selected_khz;
+    uint32_t first_failing_khz;     // 0 if every candidate passed
+    uint32_t fallbacks;             // runtime step-downs
+    uint32_t window_submitted;      // engine counters at the start of the window
+    uint32_t window_failed;
+} i2c_clock_stats_t;
+
+// Runs the self-test against every address. scratch_reg must be a register
+// nothing depends on, it is left at 0 afterwards. Returns the selected rate in kHz.
+uint32_t i2c_clock_negotiate(const uint8_t *addrs, uint8_t count, uint8_t scratch_reg);
+
+// Current bus rate, I2C_BUS_FREQUENCY_khz until negotiation ran
+uint32_t i2c_clock_get_khz(void);
+
+// Call periodically from the main loop. Steps the clock down one rate when the
+// error rate of the last window is too high. Returns true if it did.
+bool i2c_clock_monitor(void);
+
+const i2c_clock_stats_t* i2c_clock_get_stats(void);
+void i2c_clock_print_stats(void);
+
+#endif // I2C_CLOCK_H
@@ -0,0 +1,144 @@
+#include "i2c_recovery.h"
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+#include "main.h"
+#include "i2c_clock.h"
+
+#define CLOCK_OUT_HALF_PERIOD_US 5  // 100 kHz, slow enough for any target
+
+static i2c_recovery_stats_t stats;
+
+uint i2c_bus_init(void) {
+    uint baudrate = i2c_init(I2C_INSTANCE, i2c_clock_get_khz() * 1000);
+    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
+    // External pull-ups are installed, the internal ones are kept on as well so
+    // the lines idle high even with the expander board unplugged
+    gpio_pull_up(I2C_SDA_PIN);
+    gpio_pull_up(I2C_SCL_PIN);
+    return baudrate;
+}
+
+// Open-drain emulation: a line is either driven low or released to the pull-up
+static inline void line_release(uint pin) {
+    gpio_set_dir(pin, GPIO_IN);
+}
+
+static inline void line_low(uint pin) {
+    gpio_put(pin, 0);
+    gpio_set_dir(pin, GPIO_OUT);
+}
+
+bool i2c_bus_clock_out(void) {
+    gpio_init(I2C_SDA_PIN);
+    gpio_init(I2C_SCL_PIN);
+    gpio_pull_up(I2C_SDA_PIN);
+    gpio_pull_up(I2C_SCL_PIN);
+    line_release(I2C_SDA_PIN);
+    line_release(I2C_SCL_PIN);
+    sleep_us(CLOCK_OUT_HALF_PERIOD_US);
+
+    // Clock until the target lets go of SDA, it needs at most 9 pulses to finish a byte + ACK
+    for (int i = 0; i < 9 && !gpio_get(I2C_SDA_PIN); i++) {
+        line_low(I2C_SCL_PIN);
+        sleep_us(CLOCK_OUT_HALF_PERIOD_US);
+        line_release(I2C_SCL_PIN);
+        sleep_us(CLOCK_OUT_HALF_PERIOD_US);
+    }
+
+    // STOP: SDA low -> high while SCL is high
+    line_low(I2C_SDA_PIN);
+    sleep_us(CLOCK_OUT_HALF_PERIOD_US);
+    line_release(I2C_SCL_PIN);
+    sleep_us(CLOCK_OUT_HALF_PERIOD_US);
+    line_release(I2C_SDA_PIN);
+    sleep_us(CLOCK_OUT_HALF_PERIOD_US);
+
+    bool released = gpio_get(I2C_SDA_PIN) && gpio_get(I2C_SCL_PIN);
+    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
+    return released;
+}
+
+static bool run_step(i2c_recovery_step_t step, i2c_recovery_reset_t reset, void *ctx) {
+    switch (step) {
+        case I2C_RECOVERY_RETRY:
+            return true;
+        case I2C_RECOVERY_CLOCK_OUT:
+            if (!i2c_bus_clock_out()) {
+                printf("I2C recovery: SDA/SCL still held low after clock-out\n");
+            }
+            return true;
+        case I2C_RECOVERY_REINIT:
+            // Transfer state lives in the async engine, it reprograms the
+            // controller at the start of every transaction
+            i2c_bus_init();
+            return true;
+        case I2C_RECOVERY_CHIP_RESET:
+            return reset ? reset(ctx) : false;
+        default:
+            return false;
+    }
+}
+
+int i2c_recovery_run(i2c_recovery_check_t check, i2c_recovery_reset_t reset, void *ctx) {
+    uint64_t start_us = time_us_64();
+    stats.runs++;
+
+    for (int step = 0; step < I2C_RECOVERY_STEP_COUNT; step++) {
+        i2c_recovery_step_stats_t *step_stats = &stats.steps[step];
+        step_stats->attempts++;
+
+        if (!run_step((i2c_recovery_step_t)step, reset, ctx) || !check(ctx)) {
+            continue;
+        }
+
+        uint32_t elapsed_us = (uint32_t)(time_us_64() - start_us);
+        step_stats->successes++;
+        step_stats->total_us += elapsed_us;
+        if (elapsed_us > step_stats->max_us) step_stats->max_us = elapsed_us;
+        stats.last_us = elapsed_us;
+
+        printf("I2C recovery: bus healthy after %s (%luus)\n",
+               i2c_recovery_step_to_string((i2c_recovery_step_t)step), elapsed_us);
+        return step;
+    }
+
+    stats.failures++;
+    stats.last_us = (uint32_t)(time_us_64() - start_us);
+    printf("I2C recovery: every step failed (%luus)\n", stats.last_us);
+    return -1;
+}
+
+const i2c_recovery_stats_t* i2c_recovery_get_stats(void) {
+    return &stats;
+}
+
+void i2c_recovery_print_stats(void) {
+    if (stats.runs == 0) return;
+
+    printf("I2C recovery: %lu runs, %lu failed, last %luus\n", stats.runs, stats.failures, stats.last_us);
+    for (int step = 0; step < I2C_RECOVERY_STEP_COUNT; step++) {
+        const i2c_recovery_step_stats_t *step_stats = &stats.steps[step];
+        if (step_stats->attempts == 0) continue;
+        printf("  %-10s %lu/%lu recovered, avg %luus, max %luus\n",
+               i2c_recovery_step_to_string((i2c_recovery_step_t)step),
+               step_stats->successes,
+               step_stats->attempts,
+               step_stats->successes ? step_stats->total_us / step_stats->successes : 0,
+               step_stats->max_us);
+    }
+}
+
+const char* i2c_recovery_step_to_string(i2c_recovery_step_t step) {
+    switch (step) {
+        case I2C_RECOVERY_RETRY: return "retry";
+        case I2C_RECOVERY_CLOCK_OUT: return "clock-out";
+        case I2C_RECOVERY_REINIT: return "re-init";
+        case I2C_RECOVERY_CHIP_RESET: return "chip reset";
+        default: return "unknown";
+    }
+}
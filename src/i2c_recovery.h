@@ -0,0 +1,56 @@
+#ifndef I2C_RECOVERY_H
+#define I2C_RECOVERY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/types.h"
+
+// Escalating recovery for a stuck or unresponsive I2C bus. Each step is tried in
+// order until the health check passes:
+//   retry       - just check again, covers a single corrupted transfer
+//   clock-out   - 9 SCL pulses and a STOP release a target holding SDA low
+//   re-init     - reset the I2C controller at the configured speed
+//   chip reset  - pulse the expander RESET line and replay the configuration
+typedef enum {
+    I2C_RECOVERY_RETRY,
+    I2C_RECOVERY_CLOCK_OUT,
+    I2C_RECOVERY_REINIT,
+    I2C_RECOVERY_CHIP_RESET,
+    I2C_RECOVERY_STEP_COUNT
+} i2c_recovery_step_t;
+
+typedef struct {
+    uint32_t attempts;
+    uint32_t successes;         // the bus was healthy after this step
+    uint32_t total_us;          // time from the start of recovery to success
+    uint32_t max_us;
+} i2c_recovery_step_stats_t;
+
+typedef struct {
+    i2c_recovery_step_stats_t steps[I2C_RECOVERY_STEP_COUNT];
+    uint32_t runs;
+    uint32_t failures;          // every step tried, bus still unhealthy
+    uint32_t last_us;
+} i2c_recovery_stats_t;
+
+// Health check, e.g. every device answers with its expected configuration
+typedef bool (*i2c_recovery_check_t)(void *ctx);
+// Last step: reset the devices and restore their configuration
+typedef bool (*i2c_recovery_reset_t)(void *ctx);
+
+// Sets up I2C_INSTANCE and its pins at the current (negotiated) rate. Used at boot and by
+// the re-init step so both end up with the same speed and pull configuration.
+uint i2c_bus_init(void);
+
+// Releases a target holding SDA low: up to 9 SCL pulses, then a STOP.
+// Leaves the pins back on the I2C function. Returns true if SDA is high afterwards.
+bool i2c_bus_clock_out(void);
+
+// Runs the ladder, returns the step that recovered the bus or -1
+int i2c_recovery_run(i2c_recovery_check_t check, i2c_recovery_reset_t reset, void *ctx);
+
+const i2c_recovery_stats_t* i2c_recovery_get_stats(void);
+void i2c_recovery_print_stats(void);
+const char* i2c_recovery_step_to_string(i2c_recovery_step_t step);
+
+#endif // I2C_RECOVERY_H
@@ -0,0 +1,203 @@
+#include "journal.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#ifdef JOURNAL_FLASH_SPILL
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#endif
+
+#define JOURNAL_RAM_MASK (JOURNAL_RAM_ENTRIES - 1)
+_Static_assert((JOURNAL_RAM_ENTRIES & JOURNAL_RAM_MASK) == 0, "JOURNAL_RAM_ENTRIES must be a power of two");
+_Static_assert(sizeof(journal_entry_t) == 16, "journal entries are packed 16 to a flash page");
+
+static journal_entry_t ram[JOURNAL_RAM_ENTRIES];
+static uint32_t ram_head = 0;   // oldest
+static uint32_t ram_count = 0;
+
+static uint32_t next_seq = 1;
+static journal_stats_t stats;
+
+#ifdef JOURNAL_FLASH_SPILL
+#define JOURNAL_MARKER 0x4A524E4Cu  // "JRNL"
+#define JOURNAL_PAGE_ENTRIES (FLASH_PAGE_SIZE / sizeof(journal_entry_t))
+#define JOURNAL_FLASH_PAGES (JOURNAL_FLASH_SECTORS * FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define JOURNAL_PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define JOURNAL_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - JOURNAL_FLASH_SECTORS * FLASH_SECTOR_SIZE)
+
+// Flash ring of pages, entries are read back through XIP. Unread pages run from
+// flash_read_page up to flash_head_page. Pages are programmed front to back and a
+// sector is erased when the write side enters it, so the unread data always sits
+// in other sectors by then (see make_room()).
+static uint32_t flash_read_page = 0;    // oldest unread page
+static uint32_t flash_read_entry = 0;   // next entry within that page
+static uint32_t flash_head_page = 0;    // next page to program
+static uint32_t flash_pages = 0;        // programmed pages not fully read yet
+
+typedef struct {
+    uint32_t offset;
+    const journal_entry_t *page;
+    bool erase;
+} journal_flash_op_t;
+
+// Runs with the other core and XIP paused by flash_safe_execute()
+static void __not_in_flash_func(flash_write_page)(void *param) {
+    const journal_flash_op_t *op = (const journal_flash_op_t *)param;
+    if (op->erase) {
+        flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+    }
+    flash_range_program(op->offset, (const uint8_t *)op->page, FLASH_PAGE_SIZE);
+}
+
+static const journal_entry_t* flash_entry(uint32_t page, uint32_t index) {
+    return (const journal_entry_t *)(uintptr_t)(XIP_BASE + JOURNAL_FLASH_OFFSET + page * FLASH_PAGE_SIZE) + index;
+}
+
+static inline uint32_t sector_of(uint32_t page) {
+    return page / JOURNAL_PAGES_PER_SECTOR;
+}
+
+// Drops what is left of the oldest unread page
+static void drop_read_page(void) {
+    stats.dropped += JOURNAL_PAGE_ENTRIES - flash_read_entry;
+    stats.depth -= JOURNAL_PAGE_ENTRIES - flash_read_entry;
+    flash_read_page = (flash_read_page + 1) % JOURNAL_FLASH_PAGES;
+    flash_read_entry = 0;
+    flash_pages--;
+}
+
+// Before the write side erases the sector it is entering, everything still unread
+// in that sector is dropped (the ring has wrapped onto its oldest sector)
+static void make_room(void) {
+    if (flash_head_page % JOURNAL_PAGES_PER_SECTOR) return;
+    while (flash_pages && sector_of(flash_read_page) == sector_of(flash_head_page)) {
+        drop_read_page();
+    }
+    if (!flash_pages) {
+        flash_read_page = flash_head_page;
+        flash_read_entry = 0;
+    }
+}
+
+// Moves the oldest page worth of RAM entries to flash, false if that failed
+static bool spill_page(void) {
+    make_room();
+
+    journal_entry_t page[JOURNAL_PAGE_ENTRIES];
+    for (uint32_t i = 0; i < JOURNAL_PAGE_ENTRIES; i++) {
+        page[i] = ram[(ram_head + i) & JOURNAL_RAM_MASK];
+        page[i].marker = JOURNAL_MARKER;
+    }
+
+    // The first page of a sector has the sector's offset, erase it together
+    journal_flash_op_t op = {
+        .offset = JOURNAL_FLASH_OFFSET + flash_head_page * FLASH_PAGE_SIZE,
+        .page = page,
+        .erase = (flash_head_page % JOURNAL_PAGES_PER_SECTOR) == 0,
+    };
+
+    int rc = flash_safe_execute(flash_write_page, &op, 100);
+    if (rc != PICO_OK) {
+        printf("Journal flash write failed: %d\n", rc);
+        return false;
+    }
+
+    ram_head = (ram_head + JOURNAL_PAGE_ENTRIES) & JOURNAL_RAM_MASK;
+    ram_count -= JOURNAL_PAGE_ENTRIES;
+    flash_head_page = (flash_head_page + 1) % JOURNAL_FLASH_PAGES;
+    flash_pages++;
+    stats.spilled += JOURNAL_PAGE_ENTRIES;
+    return true;
+}
+#endif
+
+void journal_init(void) {
+    ram_head = 0;
+    ram_count = 0;
+    memset(&stats, 0, sizeof(stats));
+#ifdef JOURNAL_FLASH_SPILL
+    flash_read_page = 0;
+    flash_read_entry = 0;
+    flash_head_page = 0;
+    flash_pages = 0;
+#endif
+}
+
+uint32_t journal_next_seq(void) {
+    return next_seq++;
+}
+
+void journal_append(const journal_entry_t *entry) {
+    if (ram_count == JOURNAL_RAM_ENTRIES) {
+#ifdef JOURNAL_FLASH_SPILL
+        if (!spill_page())
+#endif
+        {
+            // Keep the newest history, the oldest entry goes
+            ram_head = (ram_head + 1) & JOURNAL_RAM_MASK;
+            ram_count--;
+            stats.dropped++;
+            stats.depth--;
+        }
+    }
+
+    ram[(ram_head + ram_count) & JOURNAL_RAM_MASK] = *entry;
+    ram_count++;
+    stats.appended++;
+    stats.depth++;
+    if (stats.depth > stats.high_water) stats.high_water = stats.depth;
+}
+
+bool journal_empty(void) {
+    return stats.depth == 0;
+}
+
+bool journal_peek(journal_entry_t *entry) {
+#ifdef JOURNAL_FLASH_SPILL
+    // Flash holds the older part of the history
+    while (flash_pages) {
+        const journal_entry_t *stored = flash_entry(flash_read_page, flash_read_entry);
+        if (stored->marker == JOURNAL_MARKER) {
+            *entry = *stored;
+            return true;
+        }
+        // Page did not program correctly, nothing on it can be trusted
+        printf("Journal flash page %lu unreadable, %lu entries dropped\n",
+               flash_read_page, (uint32_t)(JOURNAL_PAGE_ENTRIES - flash_read_entry));
+        drop_read_page();
+    }
+#endif
+    if (!ram_count) return false;
+    *entry = ram[ram_head];
+    return true;
+}
+
+void journal_pop(void) {
+#ifdef JOURNAL_FLASH_SPILL
+    if (flash_pages) {
+        if (++flash_read_entry == JOURNAL_PAGE_ENTRIES) {
+            flash_read_entry = 0;
+            flash_read_page = (flash_read_page + 1) % JOURNAL_FLASH_PAGES;
+            flash_pages--;
+        }
+        stats.depth--;
+        stats.replayed++;
+        return;
+    }
+#endif
+    if (!ram_count) return;
+    ram_head = (ram_head + 1) & JOURNAL_RAM_MASK;
+    ram_count--;
+    stats.depth--;
+    stats.replayed++;
+}
+
+const journal_stats_t* journal_get_stats(void) {
+    return &stats;
+}
+
+void journal_print_stats(void) {
+    printf("Journal: %lu waiting (high %lu), %lu appended, %lu replayed, %lu spilled to flash, %lu dropped, next seq %lu\n",
+           stats.depth, stats.high_water, stats.appended, stats.replayed, stats.spilled, stats.dropped, next_seq);
+}
@@ -0,0 +1,60 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Offline event journal. Alarm transitions and door changes that could not be
+// published are kept here in order, with their sequence number and the time they
+// happened, and replayed once MQTT is back. The RAM ring overflows into a flash
+// ring when built with JOURNAL_FLASH_SPILL, otherwise the oldest entries are lost.
+// The flash area is scratch space for one outage, it is not read back after a reboot.
+
+#define JOURNAL_RAM_ENTRIES 128         // power of two
+#define JOURNAL_REPLAY_INTERVAL_MS 100  // at most one replayed event per interval
+
+#ifdef JOURNAL_FLASH_SPILL
+#define JOURNAL_FLASH_SECTORS 4         // at the end of flash, 4 KB each
+#endif
+
+typedef enum {
+    JOURNAL_ALARM_STATE,    // state = new alarm_state_t, sensor = triggering sensor or SENSOR_NONE
+    JOURNAL_DOOR,           // state = open (1) / closed (0), sensor = sensor index
+} journal_kind_t;
+
+// 16 bytes, one flash page holds 16
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp_ms;  // when it happened, ms since boot
+    uint8_t kind;
+    uint8_t state;
+    uint8_t sensor;
+    uint8_t reserved;
+    uint32_t marker;        // JOURNAL_MARKER for a programmed flash entry
+} journal_entry_t;
+
+typedef struct {
+    uint32_t appended;
+    uint32_t replayed;
+    uint32_t dropped;       // lost because RAM (and flash) were full
+    uint32_t spilled;       // moved from RAM to flash
+    uint32_t depth;         // entries waiting, RAM + flash
+    uint32_t high_water;
+} journal_stats_t;
+
+void journal_init(void);
+
+// Sequence numbers are shared by live and journaled events, so a consumer can
+// merge the replay with live traffic and spot gaps
+uint32_t journal_next_seq(void);
+
+void journal_append(const journal_entry_t *entry);
+bool journal_empty(void);
+// Oldest entry, false if the journal is empty
+bool journal_peek(journal_entry_t *entry);
+void journal_pop(void);
+
+const journal_stats_t* journal_get_stats(void);
+void journal_print_stats(void);
+
+#endif // JOURNAL_H
@@ -0,0 +1,175 @@
+#include "json.h"
+#include <string.h>
+#include "cbor.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void put_char(json_writer_t *w, char c) {
+    // One byte always stays free for the NUL
+    if (w->len + 1 >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+static void put_raw(json_writer_t *w, const char *s, size_t n) {
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], s, n);
+    w->len += (uint16_t)n;
+}
+
+static void put_escaped(json_writer_t *w, const char *s) {
+    put_char(w, '"');
+    for (; *s && !w->overflow; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+            case '"':  put_raw(w, "\\\"", 2); break;
+            case '\\': put_raw(w, "\\\\", 2); break;
+            case '\n': put_raw(w, "\\n", 2); break;
+            case '\r': put_raw(w, "\\r", 2); break;
+            case '\t': put_raw(w, "\\t", 2); break;
+            default:
+                if (c < 0x20) {
+                    char esc[6] = { '\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xF] };
+                    put_raw(w, esc, sizeof(esc));
+                } else {
+                    put_char(w, (char)c);
+                }
+                break;
+        }
+    }
+    put_char(w, '"');
+}
+
+static void put_cbor_head(json_writer_t *w, uint8_t major, uint32_t value) {
+    uint8_t head[CBOR_HEAD_MAX];
+    put_raw(w, (const char *)head, cbor_head(head, major, value));
+}
+
+static void put_cbor_text(json_writer_t *w, const char *s) {
+    size_t n = strlen(s);
+    put_cbor_head(w, CBOR_MAJOR_TEXT, (uint32_t)n);
+    put_raw(w, s, n);
+}
+
+// Separator and key of the next member
+static void put_key(json_writer_t *w, const char *key) {
+    if (w->format == PAYLOAD_FORMAT_CBOR) {
+        if (!key) return;
+        uint8_t id = cbor_key_id(key);
+        if (id) {
+            put_cbor_head(w, CBOR_MAJOR_UINT, id);
+        } else {
+            put_cbor_text(w, key);
+        }
+        return;
+    }
+
+    if (w->comma) put_char(w, ',');
+    if (key) {
+        put_char(w, '"');
+        put_raw(w, key, strlen(key));
+        put_raw(w, "\":", 2);
+    }
+    w->comma = true;
+}
+
+static void put_u32(json_writer_t *w, uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    while (n) {
+        w->buf[w->len++] = digits[--n];
+    }
+}
+
+void json_init(json_writer_t *w, char *buf, size_t size) {
+    w->buf = buf;
+    w->size = size > UINT16_MAX ? UINT16_MAX : (uint16_t)size;
+    w->len = 0;
+    w->comma = false;
+    w->overflow = size == 0;
+    w->format = PAYLOAD_FORMAT_JSON;
+}
+
+void json_set_format(json_writer_t *w, payload_format_t format) {
+    if (w->len == 0 && format < PAYLOAD_FORMAT_COUNT) w->format = (uint8_t)format;
+}
+
+void json_object_begin(json_writer_t *w, const char *key) {
+    put_key(w, key);
+    put_char(w, w->format == PAYLOAD_FORMAT_CBOR ? (char)CBOR_MAP_BEGIN : '{');
+    w->comma = false;
+}
+
+void json_object_end(json_writer_t *w) {
+    put_char(w, w->format == PAYLOAD_FORMAT_CBOR ? (char)CBOR_BREAK : '}');
+    w->comma = true;
+}
+
+void json_string(json_writer_t *w, const char *key, const char *value) {
+    put_key(w, key);
+    if (w->format == PAYLOAD_FORMAT_CBOR) {
+        put_cbor_text(w, value ? value : "");
+    } else {
+        put_escaped(w, value ? value : "");
+    }
+}
+
+void json_uint(json_writer_t *w, const char *key, uint32_t value) {
+    put_key(w, key);
+    if (w->format == PAYLOAD_FORMAT_CBOR) {
+        put_cbor_head(w, CBOR_MAJOR_UINT, value);
+    } else {
+        put_u32(w, value);
+    }
+}
+
+void json_int(json_writer_t *w, const char *key, int32_t value) {
+    put_key(w, key);
+    if (w->format == PAYLOAD_FORMAT_CBOR) {
+        // Negative integers are encoded as -1 - n
+        if (value < 0) {
+            put_cbor_head(w, CBOR_MAJOR_NEGINT, (uint32_t)(-1 - value));
+        } else {
+            put_cbor_head(w, CBOR_MAJOR_UINT, (uint32_t)value);
+        }
+    } else if (value < 0) {
+        put_char(w, '-');
+        put_u32(w, (uint32_t)0 - (uint32_t)value);
+    } else {
+        put_u32(w, (uint32_t)value);
+    }
+}
+
+void json_bool(json_writer_t *w, const char *key, bool value) {
+    put_key(w, key);
+    if (w->format == PAYLOAD_FORMAT_CBOR) {
+        put_char(w, (char)(value ? CBOR_TRUE : CBOR_FALSE));
+    } else if (value) {
+        put_raw(w, "true", 4);
+    } else {
+        put_raw(w, "false", 5);
+    }
+}
+
+uint16_t json_finish(json_writer_t *w) {
+    if (w->overflow) {
+        if (w->size) w->buf[0] = '\0';
+        return 0;
+    }
+    w->buf[w->len] = '\0';
+    return w->len;
+}
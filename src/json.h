@@ -0,0 +1,46 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streaming JSON writer for outbound payloads. Members are appended straight into a
+// caller-supplied buffer (normally a publish queue slot) without printf or allocation.
+// String values are escaped, keys are expected to be plain literals. Running out of
+// room sets a sticky overflow flag and json_finish() then reports 0.
+// The same calls can emit CBOR instead (see cbor.h), selected with json_set_format().
+// No Pico SDK dependencies, so it also builds on the host.
+
+typedef enum {
+    PAYLOAD_FORMAT_JSON,
+    PAYLOAD_FORMAT_CBOR,
+    PAYLOAD_FORMAT_COUNT
+} payload_format_t;
+
+typedef struct {
+    char *buf;
+    uint16_t size;      // including the terminating NUL
+    uint16_t len;
+    bool comma;         // the next member needs a separator
+    bool overflow;
+    uint8_t format;     // payload_format_t
+} json_writer_t;
+
+void json_init(json_writer_t *w, char *buf, size_t size);
+// Switches the encoding, only before the first member is written
+void json_set_format(json_writer_t *w, payload_format_t format);
+
+// key is NULL for the root object
+void json_object_begin(json_writer_t *w, const char *key);
+void json_object_end(json_writer_t *w);
+
+void json_string(json_writer_t *w, const char *key, const char *value);
+void json_uint(json_writer_t *w, const char *key, uint32_t value);
+void json_int(json_writer_t *w, const char *key, int32_t value);
+void json_bool(json_writer_t *w, const char *key, bool value);
+
+// Returns the document length, 0 if it did not fit. JSON is NUL-terminated.
+uint16_t json_finish(json_writer_t *w);
+
+#endif // JSON_H
@@ -36,29 +36,50 @@
 #include "buttons.h"
 #include "config_fallback.h"
 #include "common.h"
-#include "mqtt.h"
-
-#define BANK0_IODIRA 0x00
-#define BANK0_IODIRB 0x01
-#define BANK0_IPOLA  0x02
-#define BANK0_IPOLB  0x03
-#define BANK0_GPINTENA 0x04
-#define BANK0_GPINTENB 0x05
-
-#define IODIRA 0x00
-#define GPIOA 0x09
+#include "events.h"
+#include "i2c_async.h"
+#include "i2c_recovery.h"
+#include "i2c_clock.h"
+#include "network.h"
+#include "resolver.h"
+#include "mqtt_queue.h"
+#include "journal.h"
 
-static char event_str[128];
-volatile bool mcp23018_interrupt_pending = false;
 // At the top of main.c, make it static global
 static MQTT_CLIENT_DATA_T mqtt_state;
 
+// Boot phase timing, printed once the hub is monitoring
+typedef struct {
+    const char *name;
+    uint32_t duration_us;
+} boot_phase_t;
+
+#define BOOT_PHASE_MAX 12
+static boot_phase_t boot_phases[BOOT_PHASE_MAX];
+static uint8_t boot_phase_count = 0;
+static uint64_t boot_phase_start_us = 0;
+
 // LED blink timer variables
 static struct repeating_timer led_timer;
+// Housekeeping tick for the event loop
+static struct repeating_timer tick_timer;
 static volatile bool led_blink_enabled = false;
 static volatile bool led_state = false;
+// The status LED hangs off the CYW43, untouched until cyw43_arch_init() succeeded
+static bool cyw43_ready = false;
 
 void gpio_event_string(char *buf, uint32_t events);
+static void handle_mcp23018_interrupt(sensor_manager_t *sensor_manager, const event_record_t *event);
+static void recover_expanders(sensor_manager_t *sensor_manager);
+static void update_status_led(alarm_context_t *alarm_ctx);
+
+// GPIO bitmask of the expander INTA lines, set once before their IRQs are enabled
+static uint64_t expander_int_pins = 0;
+
+bool tick_timer_callback(struct repeating_timer *t) {
+    events_post(HUB_EVENT_TICK);
+    return true; // keep repeating
+}
 
 // Simple LED blink timer callback
 bool led_blink_callback(struct repeating_timer *t) {
@@ -102,13 +123,10 @@ bool reserved_addr(uint8_t addr) {
     return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
 }
 
+// Runs in IRQ context - only post events here, all real work happens in the main loop
 void gpio_callback(uint gpio, uint32_t events) {
-    gpio_event_string(event_str, events);
-    printf("GPIO %d %s\n", gpio, event_str);
-    
-    if (gpio == INTERRUPT_PIN) {
-        printf("\\Door sensor interrupt being handled.../\n\n");
-        mcp23018_interrupt_pending = true;
+    if (gpio < 64 && (expander_int_pins & (1ull << gpio))) {
+        events_push(EVENT_RING_GPIO, HUB_EVENT_MCP_INTERRUPT, gpio, gpio_get(gpio), events);
     }
     else if (gpio == ARM_SWITCH_PIN || gpio == RESET_BUTTON_PIN) {
         // Forward button events to button handler
@@ -116,7 +134,38 @@ void gpio_callback(uint gpio, uint32_t events) {
     }
 }
 
-void bus_scan() {
+// Closes the current boot phase, the next one starts now
+static void boot_phase_done(const char *name) {
+    uint64_t now_us = time_us_64();
+    if (boot_phase_count < BOOT_PHASE_MAX) {
+        boot_phases[boot_phase_count].name = name;
+        boot_phases[boot_phase_count].duration_us = (uint32_t)(now_us - boot_phase_start_us);
+        boot_phase_count++;
+    }
+    boot_phase_start_us = now_us;
+}
+
+static void boot_print_phases(void) {
+    uint32_t total_us = 0;
+    printf("Boot phases:\n");
+    for (uint8_t i = 0; i < boot_phase_count; i++) {
+        printf("  %-18s %6lu ms\n", boot_phases[i].name, boot_phases[i].duration_us / 1000);
+        total_us += boot_phases[i].duration_us;
+    }
+    printf("  %-18s %6lu ms (%llu ms since reset)\n", "total", total_us / 1000, time_us_64() / 1000);
+}
+
+// Full scan of the bus, on demand only (MQTT "scan" command). Returns the number of
+// devices found and stores up to max_found of their addresses.
+int bus_scan(uint8_t *found, int max_found) {
+    int found_count = 0;
+
+    // The async engine owns the controller, wait until it is idle. Transfers are
+    // only queued from the main loop, so it stays idle while the scan runs.
+    while (i2c_async_busy()) {
+        __wfe();
+    }
+
     printf("\nI2C Bus Scan\n");
     printf("   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
 
@@ -136,200 +185,214 @@ void bus_scan() {
         if (reserved_addr(addr))
             ret = PICO_ERROR_GENERIC;
         else
-            ret = i2c_read_timeout_us(I2C_INSTANCE, addr, &rxdata, 1, false, 10000); // 10ms timeout
+            ret = i2c_read_timeout_us(I2C_INSTANCE, addr, &rxdata, 1, false, I2C_PROBE_TIMEOUT_US);
 
+        if (ret >= 0) {
+            if (found_count < max_found) found[found_count] = (uint8_t)addr;
+            found_count++;
+        }
         printf(ret < 0 ? "." : "@");
         printf(addr % 16 == 15 ? "\n" : "  ");
     }
     printf("Done.\n");
+    return found_count;
 }
 
-int main() {
-    // initialization
-    stdio_init_all();
+static void handle_mcp23018_interrupt(sensor_manager_t *sensor_manager, const event_record_t *event) {
+    uint gpio = event->pin;
+    // Handle the interrupt from the MCP23018
+#if DEBUG_MCP23018_INTERRUPTS
+    printf("Handling MCP23018 interrupt on GP%u\n", gpio);
+#endif
     
-    if (cyw43_arch_init()) {
-        printf("Wi-Fi init failed");
-        return -1;
+    // Verify interrupt pin is still low
+    if (gpio_get(gpio)) {
+        printf("False interrupt on GP%u - pin already high\n", gpio);
+        return;
     }
-
-    alarm_context_t *alarm_ctx = alarm_init();
-
-    // Initialize LED blink timer
-    add_repeating_timer_ms(250, led_blink_callback, alarm_ctx, &led_timer);
-    printf("LED blink timer initialized\n");
     
-    // turn LED to indicating code is running
-    cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
-    led_blink_enabled = true;
+    // CRITICAL: RP2350 Issue with MCP23018
+    // Reading ANY register (including INTFA) while interrupt pin is asserted 
+    // causes NACK on next transaction
+    // MUST read INTCAPA first to clear interrupt before MCP23018 responds properly
+    // This has been debugged and no root cause found in MCP23018 or RP2350 docs, 
+    // people on forums also reported random issues with MCP23017 on raspberry pi
+    // The burst read starts at INTFA but is a single transaction, INTCAP is read
+    // (and the interrupt cleared) before any following transaction starts.
+    //
+    // No delay here: the capture is read right away and the sensor manager
+    // debounces each pin with a timed re-sample, measured from the IRQ timestamp.
     
-    MQTT_CLIENT_DATA_T* mqtt_ctx = mqtt_init();
-    if (!mqtt_ctx) {
-        printf("mqtt client instant ini error\n");
-        return 0;
+    // The reads run on the I2C IRQ, results come back as HUB_EVENT_MCP_CAPTURE
+    sensor_service_interrupt_line(sensor_manager, gpio, event->timestamp_us);
+}
+
+static void recover_expanders(sensor_manager_t *sensor_manager) {
+    printf("MCP23018 I2C failure detected, running bus recovery...\n");
+    if (!sensor_recover_bus(sensor_manager)) {
+        printf("I2C bus could not be recovered, retrying on the next failure\n");
     }
+}
 
-    
-    cyw43_arch_enable_sta_mode();
-
-    int wifi_status;
-    if ((wifi_status = cyw43_arch_wifi_connect_timeout_ms(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, 30000)) != 0)
-    {
-        printf("failed to connect (%d): ", wifi_status);
-        if (wifi_status == PICO_ERROR_BADAUTH) printf("Invalid Wifi credentials");
-        else if (wifi_status == PICO_ERROR_TIMEOUT) printf("Connection timed out");
-        else if (wifi_status == PICO_ERROR_CONNECT_FAILED) printf("Could not connect to wifi for some reason...");
-        else printf("Unknown error code %d", wifi_status);
-        puts("");
-        return 1;
+// Update LED based on alarm state (asynchronous blinking handled by timer)
+static void update_status_led(alarm_context_t *alarm_ctx) {
+    if (!cyw43_ready) return;
+
+    switch (alarm_ctx->current_state) {
+        case ALARM_STATE_DISARMED:
+            led_blink_enabled = false;
+            cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);  // OFF
+            break;
+        case ALARM_STATE_ARMED:
+            led_blink_enabled = false;
+            cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);  // SOLID ON
+            break;
+        case ALARM_STATE_ARMING:
+        case ALARM_STATE_TRIGGERING:
+            led_blink_enabled = true;   // slow blink
+            break;
+        case ALARM_STATE_TRIGGERED:
+            led_blink_enabled = true;  // Timer will handle blinking
+            break;
+        default:
+            break;
     }
+}
 
-    printf("\nConnected to Wifi\n");
+int main() {
+    // initialization
+    stdio_init_all();
+    events_init();
+    journal_init();
+    // boot_phase_start_us is 0 and the timer counts from reset, so the first phase
+    // covers the boot ROM, runtime init and stdio
+    boot_phase_done("reset to stdio");
+
+    // Sensors and the alarm come up first, Wi-Fi and MQTT are brought up in the
+    // background once the hub is already monitoring
+    alarm_context_t *alarm_ctx = alarm_init();
 
-    if(mqtt_connect(mqtt_ctx, MQTT_SERVER) != 0) {
-        printf("MQTT connection failed\n");
-        return -1;
-    }
-    
-    printf("MQTT connection initiated, waiting for callback...\n");
-    
-    // Initialize interrupt pin but DON'T enable interrupt yet
-    // Must configure MCP23018 first to avoid spurious interrupts during init
-    gpio_init(INTERRUPT_PIN);
-    gpio_set_dir(INTERRUPT_PIN, GPIO_IN);
-    gpio_pull_up(INTERRUPT_PIN);  // Pull up since INTA is open-drain, active low
 #if !defined(I2C_INSTANCE) || !defined(I2C_SDA_PIN) || !defined(I2C_SCL_PIN)
 #warning i2c/bus_scan example requires a board with I2C pins
     puts("I2C pins were not defined");
 #else
 
-    uint actual_baudrate = i2c_init(I2C_INSTANCE, I2C_BUS_FREQUENCY_khz * 1000);  // Try 50kHz
-    printf("I2C initialized at %u Hz (requested 50kHz for RP2350 compatibility)\n", actual_baudrate);
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
-    // IMPORTANT: External pull-ups are installed, so disable internal pull-ups
-    // Having both can cause signal integrity issues and timing violations
-    gpio_pull_up(I2C_SDA_PIN);
-    gpio_pull_up(I2C_SCL_PIN);
+    // Same speed and pull configuration as the recovery re-init step
+    uint actual_baudrate = i2c_bus_init();
+    printf("I2C initialized at %u Hz, raised by the clock self-test once the expanders are found\n", actual_baudrate);
     // Make the I2C pins available to picotool
     bi_decl(bi_2pins_with_func(I2C_SDA_PIN, I2C_SCL_PIN, GPIO_FUNC_I2C));
 
+    // All MCP23018 register access goes through the interrupt-driven engine
+    i2c_async_init(I2C_INSTANCE);
+
     // Initialize MCP23018 RESET pin - keep HIGH for normal operation
     gpio_init(MCP23018_RESET_PIN);
     gpio_set_dir(MCP23018_RESET_PIN, GPIO_OUT);
     gpio_put(MCP23018_RESET_PIN, 1);  // HIGH = normal operation (active LOW reset)
     printf("MCP23018 RESET pin initialized on GP%d\n", MCP23018_RESET_PIN);
 
-    mqtt_set_alarm_context(alarm_ctx);
-
     // Initialize button manager
     button_manager_t button_manager;
     buttons_init(&button_manager, alarm_ctx);
     
-    // Configure sensors with reduced memory footprint
-    sensor_manager_t *sensor_manager = sensor_manager_init(mqtt_ctx, alarm_ctx);
+    // The MQTT context is attached once the network stack is up
+    sensor_manager_t *sensor_manager = sensor_manager_init(NULL, alarm_ctx);
     if (!sensor_manager) {
         printf("Failed to initialize sensor manager\n");
         return -1;
     }
 
-    sleep_ms(100);  // Allow time for I2C to stabilize
+    // Initialize interrupt pins but DON'T enable interrupts yet
+    // Must configure the expanders first to avoid spurious interrupts during init
+    for (uint gpio = 0; gpio < 64; gpio++) {
+        if (!(sensor_manager->interrupt_pins & (1ull << gpio))) continue;
+        gpio_init(gpio);
+        gpio_set_dir(gpio, GPIO_IN);
+        gpio_pull_up(gpio);  // Pull up since INTA is open-drain, active low
+    }
+
+    boot_phase_done("i2c + sensors init");
 
     // Reset MCP23018 hardware to ensure clean state
     // Can be removed, but during testing it caused previous states to carry over
     // anyhow, the sensor hub is planned to be running 24/7
     // mcp23018_hardware_reset();
 
+    // Only the configured addresses are probed, the full bus scan is available
+    // as the "scan" MQTT command
     puts("===========================\nQuick device check...");
-    bus_scan();
-    uint8_t test_byte;
-    int result;
-    int max_attempts = 5;
-    int attempts_count = max_attempts;
-    while(attempts_count--) {
-        result = i2c_read_blocking(I2C_INSTANCE, EXPANDER_ADDR, &test_byte, 1, false);
-        if (result < 0) {
-            printf("ERROR: MCP23018 not responding at expected address! %02x\n", EXPANDER_ADDR);
-            if(attempts_count % max_attempts == 0) bus_scan();
-        } else {
-            printf("Device found at 0x%02x\n", EXPANDER_ADDR);
-            break;  // Device found, exit loop
+    for (uint8_t i = 0; i < sensor_manager->expander_count; i++) {
+        uint8_t addr = sensor_manager->expanders[i].dev.addr;
+        uint8_t test_byte;
+        bool found = false;
+        for (int attempt = 0; attempt < I2C_PROBE_ATTEMPTS && !found; attempt++) {
+            found = i2c_read_timeout_us(I2C_INSTANCE, addr, &test_byte, 1, false, I2C_PROBE_TIMEOUT_US) >= 0;
         }
+        if (!found) {
+            printf("ERROR: MCP23018 not responding at expected address! %02x (send the scan command to list the bus)\n", addr);
+            return -1;
+        }
+        printf("Device found at 0x%02x\n", addr);
     }
-    if (!attempts_count) return -1;
+    boot_phase_done("expander probe");
 
-    puts("////////////////\n\nReading IODIR register");
-    uint8_t iodir_data;
-    if (mcp23018_read8(IODIRA, &iodir_data) == 1) {
-        printf("Read IODIR: 0x%02x\n", iodir_data);
-    } else {
-        puts("Failed to read IODIR");
+    if (sensor_configure_expanders(sensor_manager) != sensor_manager->expander_count) {
+        puts("Failed to configure all MCP23018 expanders");
     }
-
-    mcp23018_iocon_t iocon = {
-        .INTCC = 1,
-        .INTPOL = 0,  // INTA is active LOW (open-drain)
-        .reserved1 = 0,
-        .reserved2 = 0,
-        .reserved3 = 0,
-        .SEQOP = 1,
-        .MIRROR = 0,
-        .BANK = 1
-    };
-    mcp23018_configure_iocon(I2C_INSTANCE, EXPANDER_ADDR, &iocon);
-    //mcp23018_store8(IOCON_BANK0, 0xa0);
-    mcp23018_store8(IODIRA, sensor_manager->active_sensor_mask);  // Set all pins as inputs except GP0
-
-    puts("\n===Configured MCP23018 - all pins as inputs except GP0===\n");
-
-    sleep_ms(10);
-
-    mcp23018_store8(GPINTENA_BANK1, 0x80);  // Enable interrupt on GPA7
-    mcp23018_store8(INTCONA_BANK1, 0x00);   // Compare against previous value (edge detection)
-    // Remove DEFVALA setting since we're using previous value mode
-
-    puts("Verifying...");
-
-    uint8_t new_iocon_data;
-    if (mcp23018_read8(IOCON_BANK1, &new_iocon_data) == 1) {
-        printf("Read IOCON: 0x%02x\n", new_iocon_data);
-    } else {
-        puts("Failed to read IOCON");
+    puts("\n===Configured MCP23018 - sensor pins as inputs on both ports===\n");
+    boot_phase_done("expander config");
+
+    // Step the clock up as far as every expander reads back cleanly. Only after the
+    // configuration: a warm reset can leave a chip in BANK=1, where the BANK=0 DEFVALA
+    // address is GPPUA. Now DEFVAL is unused (INTCON = 0) and serves as the scratch
+    // register, the negotiation leaves it at the configured 0.
+    uint8_t expander_addrs[MAX_EXPANDERS];
+    for (uint8_t i = 0; i < sensor_manager->expander_count; i++) {
+        expander_addrs[i] = sensor_manager->expanders[i].dev.addr;
     }
-
-    uint8_t new_iodir_data;
-    if (mcp23018_read8(IODIRA, &new_iodir_data) == 1) {
-        printf("Read IODIR: 0x%02x\n", new_iodir_data);
-    } else {
-        puts("Failed to read IODIR");
+    i2c_clock_negotiate(expander_addrs, sensor_manager->expander_count, MCP23018_DEFVALA);
+    boot_phase_done("i2c clock test");
+
+    // Now that the expanders are fully configured, enable interrupt handling
+    expander_int_pins = sensor_manager->interrupt_pins;
+    for (uint gpio = 0; gpio < 64; gpio++) {
+        if (!(expander_int_pins & (1ull << gpio))) continue;
+        gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
+        printf("MCP23018 interrupt handler enabled on GP%u\n", gpio);
     }
-    puts("\n");
-
-    sleep_ms(100);
-
-    mcp23018_store8(GPIOA, 0x1);  // Set all pins HIGH
 
-    sleep_ms(100);
+    // Housekeeping tick replaces the fixed sleep in the loop for everything time based
+    add_repeating_timer_ms(HUB_TICK_INTERVAL_MS, tick_timer_callback, NULL, &tick_timer);
+    boot_phase_done("monitoring");
 
-    puts("Testing read");
-
-    uint8_t data;
-    if (mcp23018_read8(GPIOA, &data) == 1) {
-        printf("Read GPIOA: 0x%02x\n", data);
+    // Door changes and alarm transitions from here on stay queued in their rings
+    // until MQTT is connected, the alarm itself never waits for the network
+    MQTT_CLIENT_DATA_T* mqtt_ctx = NULL;
+    if (cyw43_arch_init()) {
+        printf("Wi-Fi init failed, monitoring without network\n");
     } else {
-        puts("Failed to read GPIOA");
-    }
+        cyw43_ready = true;
 
-    if (!gpio_get(INTERRUPT_PIN)) {
-        // clear interrupt
-        if(mcp23018_read8(INTCAPA_BANK1, &data) < 0) {
-            puts("Failed to read interrupt capture");
+        // Initialize LED blink timer
+        add_repeating_timer_ms(250, led_blink_callback, alarm_ctx, &led_timer);
+        printf("LED blink timer initialized\n");
+        update_status_led(alarm_ctx);
+
+        mqtt_ctx = mqtt_init();
+        if (!mqtt_ctx) {
+            printf("mqtt client instant ini error\n");
+        } else {
+            mqtt_set_alarm_context(alarm_ctx);
+            sensor_manager->mqtt_ctx = mqtt_ctx;
+            network_init(mqtt_ctx);
+            network_apply_alarm_state(alarm_ctx->current_state);
+            // Join, DNS and MQTT connect progress on the network ring and the tick
+            network_start();
         }
     }
-
-    // Now that MCP23018 is fully configured, enable interrupt handling
-    gpio_set_irq_enabled_with_callback(INTERRUPT_PIN, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
-    printf("MCP23018 interrupt handler enabled on GP%d\n", INTERRUPT_PIN);
+    boot_phase_done("cyw43 init");
+    boot_print_phases();
 
     // Initialize rate limiter variables
     uint32_t last_print_time = 0;
@@ -337,94 +400,145 @@ int main() {
     uint32_t last_status_time = 0;
 
     while (true) {
+        // Sleeps with __wfe() until an ISR, timer or lwIP callback posts an event
+        uint32_t events = events_wait(EVENT_LOOP_POLL_MS);
+
+        // Drain every queued edge, several can arrive between two wakeups
+        event_record_t event;
+        while (events_pop(EVENT_RING_GPIO, &event)) {
+            events_mark_record_handled(&event);
+            switch ((hub_event_t)event.type) {
+                case HUB_EVENT_MCP_INTERRUPT:
+                    handle_mcp23018_interrupt(sensor_manager, &event);
+                    break;
+                case HUB_EVENT_ARM_SWITCH:
+                case HUB_EVENT_RESET_BUTTON:
+                    buttons_handle_event(&event);
+                    break;
+                default:
+                    break;
+            }
+        }
 
-        if (mcp23018_interrupt_pending) {
-            mcp23018_interrupt_pending = false;
-            // Handle the interrupt from the MCP23018
-            uint8_t intcap;
-            uint8_t intf;
-            printf("Handling MCP23018 interrupt...");
-            
-            // Verify interrupt pin is still low
-            if (gpio_get(INTERRUPT_PIN)) {
-                printf("False interrupt - pin already high\n");
-                continue;
+        while (events_pop(EVENT_RING_I2C, &event)) {
+            events_mark_record_handled(&event);
+            bool ok = true;
+            switch ((hub_event_t)event.type) {
+                case HUB_EVENT_MCP_CAPTURE:
+                    ok = sensor_handle_capture(sensor_manager, &event);
+                    break;
+                case HUB_EVENT_MCP_RESAMPLE:
+                    ok = sensor_handle_resample(sensor_manager, &event);
+                    break;
+                default:
+                    break;
             }
-            
-            // CRITICAL: RP2350 Issue with MCP23018
-            // Reading ANY register (including INTFA) while interrupt pin is asserted 
-            // causes NACK on next transaction
-            // MUST read INTCAPA first to clear interrupt before MCP23018 responds properly
-            // This has been debugged and no root cause found in MCP23018 or RP2350 docs, 
-            // people on forums also reported random issues with MCP23017 on raspberry pi
-            
-            sleep_ms(10);  // Debounce delay
-            
-            // Read INTCAPA first - this clears the interrupt and makes MCP23018 responsive
-            // Reading INTCAPA also clears INTF, so we use active_sensor_mask to know which sensors
-            int read_result = mcp23018_read8(INTCAPA_BANK1, &intcap);
-            if (read_result == 1) {
-                printf("Interrupt capture: 0x%02x (interrupt cleared)\n", intcap);
-                
-                // Use active_sensor_mask since INTF is cleared when INTCAP is read
-                // This works because we control which pins have interrupts enabled via GPINTENA
-                intf = sensor_manager->active_sensor_mask;
-                printf("Active sensor mask: 0x%02x\n", intf);
-                
-                sensor_handle_interrupt(sensor_manager, intf, intcap);
-            } else {
-                printf("Failed to read INTCAP (error: %d) - MCP23018 I2C lockup detected\n", read_result);
-                printf("Performing hardware reset to recover...\n");
-                mcp23018_hardware_reset();
+            if (!ok) {
+                recover_expanders(sensor_manager);
             }
         }
-        
 
-        current_time = to_ms_since_boot(get_absolute_time());
+        while (events_pop(EVENT_RING_TIMER, &event)) {
+            events_mark_record_handled(&event);
+            if (event.type == HUB_EVENT_DEBOUNCE_DUE) {
+                sensor_debounce_due(sensor_manager, &event);
+            }
+        }
 
-        if (current_time - last_print_time >= 6000) {
-            printf("Alarm state: %s; MQTT: %s; Interrupt pin: %d\n", 
-                alarm_state_to_string(alarm_ctx->current_state),
-                mqtt_is_connected(mqtt_ctx) ? "connected" : "disconnected",
-                gpio_get(INTERRUPT_PIN));
-            last_print_time = current_time;
+        while (events_pop(EVENT_RING_NETWORK, &event)) {
+            events_mark_record_handled(&event);
+            switch ((hub_event_t)event.type) {
+                case HUB_EVENT_MQTT_COMMAND:
+                    mqtt_process_command(mqtt_ctx, &event);
+                    break;
+                case HUB_EVENT_MQTT_CONNECTION:
+                    // Requests lwIP dropped with the old connection never complete
+                    mqtt_queue_reset_in_flight();
+                    // Pending publishes are flushed by mqtt_check_and_publish below
+                    network_handle_event(&event);
+                    break;
+                case HUB_EVENT_DNS_RESULT:
+                    network_handle_event(&event);
+                    break;
+                default:
+                    break;
+            }
         }
 
-        // Update LED based on alarm state (asynchronous blinking handled by timer)
-        switch (alarm_ctx->current_state) {
-            case ALARM_STATE_DISARMED:
-                led_blink_enabled = false;
-                cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);  // OFF
-                break;
-            case ALARM_STATE_ARMED:
-                led_blink_enabled = false;
-                cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);  // SOLID ON
-                break;
-            case ALARM_STATE_TRIGGERING:
-                led_blink_enabled = true;   // slow blink
-                break;
-            case ALARM_STATE_TRIGGERED:
-                led_blink_enabled = true;  // Timer will handle blinking
-                break;
+        // Single consumer for every alarm input, transitions are applied in posting order
+        alarm_process_events(alarm_ctx);
+
+        if (events & HUB_EVENT_BIT(HUB_EVENT_ALARM_CHANGED)) {
+            events_mark_handled(HUB_EVENT_ALARM_CHANGED);
+            update_status_led(alarm_ctx);
+            // Radio wake-up latency follows the alarm state
+            if (mqtt_ctx) {
+                network_apply_alarm_state(alarm_ctx->current_state);
+            }
         }
 
-        mqtt_check_and_publish(mqtt_ctx, alarm_ctx);
+        if (events & HUB_EVENT_BIT(HUB_EVENT_MQTT_PUBLISHED)) {
+            // Retried by mqtt_check_and_publish below
+            events_mark_handled(HUB_EVENT_MQTT_PUBLISHED);
+        }
+
+        if (events & HUB_EVENT_BIT(HUB_EVENT_JOURNAL_REPLAY)) {
+            // Next journaled event goes out from mqtt_check_and_publish below
+            events_mark_handled(HUB_EVENT_JOURNAL_REPLAY);
+        }
+
+        if (events & HUB_EVENT_BIT(HUB_EVENT_TICK)) {
+            events_mark_handled(HUB_EVENT_TICK);
+            current_time = to_ms_since_boot(get_absolute_time());
+
+            if (current_time - last_print_time >= 6000) {
+                // INTA is active low: a set bit is an expander line held asserted
+                printf("Alarm state: %s; Network: %s; INTA asserted: 0x%llx of 0x%llx\n",
+                    alarm_state_to_string(alarm_ctx->current_state),
+                    network_state_to_string(network_get_state()),
+                    (unsigned long long)(~gpio_get_all64() & expander_int_pins),
+                    (unsigned long long)expander_int_pins);
+                last_print_time = current_time;
+            }
 
-        // will only process if mqtt->reconnect_needed is set to true, otherwise it instantly returns
-        mqtt_handle_reconnection(mqtt_ctx);
-
-        if(current_time - last_status_time >= 30000) {
-            system_status_t status = {
-                .wifi_status = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_UP ? "connected" : "disconnected",
-                .mqtt_status = mqtt_is_connected(mqtt_ctx) ? "connected" : "disconnected",
-                .uptime_ms = current_time,
-                .sensor_count = sensor_manager ? sensor_manager->sensor_count : 0,
-            };
-            mqtt_publish_system_status(mqtt_ctx, &status, alarm_ctx);
-            last_status_time = current_time;
+            // Falls back to a slower I2C clock if transfers started failing
+            i2c_clock_monitor();
+
+            // Join / DNS / connect timeouts and reconnect backoff
+            if (mqtt_ctx) {
+                network_tick();
+            }
+
+            if(current_time - last_status_time >= 30000) {
+                system_status_t status = {
+                    .wifi_status = network_wifi_up() ? "connected" : "disconnected",
+                    .mqtt_status = mqtt_is_connected(mqtt_ctx) ? "connected" : "disconnected",
+                    .uptime_ms = current_time,
+                    .sensor_count = sensor_manager ? sensor_manager->sensor_count : 0,
+                };
+                mqtt_publish_system_status(mqtt_ctx, &status, alarm_ctx);
+                if (mqtt_ctx) {
+                    mqtt_publish_link_status(mqtt_ctx, network_get_link_stats());
+                    network_print_stats();
+                    resolver_print_stats();
+                    mqtt_print_tls_stats();
+                    mqtt_queue_print_stats();
+                    mqtt_print_payload_stats();
+                }
+                journal_print_stats();
+                events_print_latency();
+                sensor_print_stats(sensor_manager);
+                i2c_recovery_print_stats();
+                i2c_clock_print_stats();
+                const i2c_async_stats_t *i2c_stats = i2c_async_get_stats();
+                printf("I2C: %lu ok, %lu failed (%lu timeouts), %lu queue full, max %luus\n",
+                       i2c_stats->completed, i2c_stats->failed, i2c_stats->timeouts,
+                       i2c_stats->queue_full, i2c_stats->max_duration_us);
+                last_status_time = current_time;
+            }
         }
 
-        sleep_ms(50);
+        mqtt_check_and_publish(mqtt_ctx, alarm_ctx);
     }
 
     return 0;
@@ -1,6 +1,8 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include <stdint.h>
+
 #define DEVICE_NAME "pico_w_1"
 
 #define EXPANDER_ADDR 0x20
@@ -11,24 +13,21 @@
 #define I2C_SCL_PIN 19
 #define MCP23018_RESET_PIN 21
 
-#define I2C_BUS_FREQUENCY_khz 50  // kHz
-
-#define IOCON_BANK0 0x0A
-#define IOCON_BANK1 0x05
-
-#define GPIOA_BANK0 0x12
-#define GPIOA_BANK1 0x09
-
-#define GPINTENA_BANK1 0x02
-
-#define DEFVALA_BANK1 0x03
-
-#define INTCONA_BANK1 0x04
+#define I2C_BUS_FREQUENCY_khz 50  // kHz, boot rate before the clock self-test
+#define I2C_CLOCK_MAX_khz 1000     // fastest rate the self-test may select
+#define I2C_PROBE_TIMEOUT_US 2000   // per address, boot probe and bus scan
+#define I2C_PROBE_ATTEMPTS 3
 
-#define INTFA_BANK1 0x07
+// 0 = main loop sleeps with __wfe() until an event is posted.
+// Set to e.g. 50 to get the old fixed-period polling behaviour for latency comparisons.
+#define EVENT_LOOP_POLL_MS 0
 
-#define INTCAPA_BANK1 0x08
+// 1 = log every MCP23018 interrupt as it is dispatched. Off by default, the printf
+// takes longer than the rest of the interrupt path.
+#define DEBUG_MCP23018_INTERRUPTS 0
 
 void detailed_panic(const char *fmt, ...);
+// Full I2C bus scan for diagnostics, returns the number of devices found
+int bus_scan(uint8_t *found, int max_found);
 
 #endif // MAIN_H
\ No newline at end of file
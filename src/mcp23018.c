@@ -1,140 +1,200 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
 #include "hardware/i2c.h"
 #include "pico/cyw43_arch.h"
 #include "main.h"
 #include "mcp23018.h"
+#include "i2c_async.h"
 
-#define MCP23018_IODIRA   0x00
-// MCP23018 register addresses (BANK=0 mode)
-#define MCP23018_IODIRB_BANK0   0x01
-#define MCP23018_GPIOA_BANK0    0x12
-#define MCP23018_GPIOB_BANK0    0x13
-#define MCP23018_IOCON_BANK0    0x0a
-
-// MCP23018 register addresses (BANK=1 mode)
-#define MCP23018_IODIRB_BANK1   0x10
-#define MCP23018_GPIOA_BANK1    0x09
-#define MCP23018_GPIOB_BANK1    0x19
-#define MCP23018_IOCON_BANK1    0x05
-
-void mcp23018_init(i2c_inst_t *i2c, uint8_t addr) {
-    // Initialize with default IOCON settings
-    mcp23018_iocon_t iocon = {
-        .INTCC = 0,
-        .INTPOL = 0,
-        .reserved1 = 0,
-        .reserved2 = 0,
-        .reserved3 = 0,
-        .SEQOP = 0,
-        .MIRROR = 0,
-        .BANK = 0
-    };
+static inline bool is_config_reg(uint8_t reg) {
+    return reg <= MCP23018_GPPUB || reg == MCP23018_OLATA || reg == MCP23018_OLATB;
+}
 
-    mcp23018_configure_iocon(i2c, addr, &iocon);
+// Power-on register values (IODIR all inputs, everything else 0)
+static void shadow_set_defaults(mcp23018_t *dev) {
+    memset(dev->shadow, 0, sizeof(dev->shadow));
+    dev->shadow[MCP23018_IODIRA] = 0xFF;
+    dev->shadow[MCP23018_IODIRB] = 0xFF;
 }
 
-void mcp23018_configure_iocon(i2c_inst_t *i2c, uint8_t addr, mcp23018_iocon_t *iocon) {
-    int res;
-    if (iocon->BANK) {
-        res = mcp23018_store8(IOCON_BANK0, 0x80);
-        if (res < 0) {
-            printf("Failed to configure IOCON_BANK0\n");
-        }
+// Record written values. GPIO writes land in OLAT, INTF/INTCAP are read-only.
+static void shadow_record(mcp23018_t *dev, uint8_t reg, const uint8_t *data, uint8_t len) {
+    for (uint8_t i = 0; i < len && reg + i < MCP23018_REG_COUNT; i++) {
+        uint8_t r = reg + i;
+        if (r == MCP23018_GPIOA || r == MCP23018_GPIOB) r += MCP23018_OLATA - MCP23018_GPIOA;
+        if (is_config_reg(r)) dev->shadow[r] = data[i];
     }
+    if (reg <= MCP23018_IOCON && reg + len > MCP23018_IOCON) {
+        // IOCON is visible at both 0x0A and 0x0B
+        dev->shadow[MCP23018_IOCON + 1] = dev->shadow[MCP23018_IOCON];
+    }
+}
+
+void mcp23018_init(mcp23018_t *dev, uint8_t addr, uint8_t int_pin) {
+    dev->addr = addr;
+    dev->int_pin = int_pin;
+    dev->shared_int = false;
+    dev->restore_count = 0;
+    dev->last_restore_us = 0;
+    shadow_set_defaults(dev);
+}
+
+int mcp23018_write_regs(mcp23018_t *dev, uint8_t reg, const uint8_t *data, uint8_t len) {
+    int res = i2c_async_write_blocking(dev->addr, reg, data, len);
+    if (res >= 0) {
+        shadow_record(dev, reg, data, len);
+    }
+    return res;
+}
+
+void mcp23018_configure_iocon(mcp23018_t *dev, mcp23018_iocon_t *iocon) {
+    int res;
     // Convert bit structure to byte value
     uint8_t iocon_value = 0;
     iocon_value |= (iocon->INTCC & 0x01) << 0;
     iocon_value |= (iocon->INTPOL & 0x01) << 1;
+    iocon_value |= (iocon->ODR & 0x01) << 2;
     iocon_value |= (iocon->SEQOP & 0x01) << 5;
     iocon_value |= (iocon->MIRROR & 0x01) << 6;
     iocon_value |= (iocon->BANK & 0x01) << 7;
-    
-    
-    res = mcp23018_store8(IOCON_BANK1, iocon_value);
+
+    if (iocon->BANK) {
+        // Switch to BANK=1 first, then IOCON moves to its BANK=1 address.
+        // The shadow only describes BANK=0 layouts, so it is not updated here.
+        res = i2c_async_write_blocking(dev->addr, MCP23018_IOCON, (uint8_t[]){ 0x80 }, 1);
+        if (res < 0) {
+            printf("Failed to configure IOCON (BANK=0 address)\n");
+        }
+        res = i2c_async_write_blocking(dev->addr, MCP23018_IOCON_BANK1, &iocon_value, 1);
+    } else {
+        // If the chip is still in BANK=1 from a previous run, IOCON is at 0x05 and this
+        // write switches it back. In BANK=0 that address is GPINTENB, so the shadow
+        // value is written straight back afterwards.
+        res = i2c_async_write_blocking(dev->addr, MCP23018_IOCON_BANK1, &iocon_value, 1);
+        if (res < 0) {
+            printf("Failed to configure IOCON (BANK=1 address)\n");
+        }
+        res = mcp23018_store8(dev, MCP23018_IOCON, iocon_value);
+        if (res >= 0) {
+            res = mcp23018_store8(dev, MCP23018_GPINTENB, dev->shadow[MCP23018_GPINTENB]);
+        }
+    }
     if (res < 0) {
-        printf("Failed to configure IOCON\n");
+        printf("Failed to configure IOCON on 0x%02x\n", dev->addr);
     }
 }
 
-int mcp23018_read8(uint8_t reg, uint8_t *data) {
-    // Use the 7-bit address directly - Pico SDK handles R/W bit
-    int res;
-    
-    //printf("DEBUG: Writing register 0x%02x to device 0x%02x\n", reg, EXPANDER_ADDR);
-    res = i2c_write_blocking(i2c_default, EXPANDER_ADDR, &reg, 1, true);  // true = keep control
-    //printf("DEBUG: Write result: %d\n", res);
-    if (res < 1) {
-        printf("DEBUG: Write error code: %d\n", res);
+int mcp23018_configure_inputs(mcp23018_t *dev, uint16_t input_mask) {
+    mcp23018_iocon_t iocon = {
+        .INTCC = 1,
+        .INTPOL = 0,                // INTA is active LOW
+        .ODR = dev->shared_int,     // open-drain so expanders sharing a line don't fight
+        .reserved2 = 0,
+        .reserved3 = 0,
+        .SEQOP = 0,                 // sequential mode, needed for the INTF/INTCAP/GPIO burst read
+        .MIRROR = 1,                // port B changes also assert INTA
+        .BANK = 0                   // ports interleaved so INTF..GPIO of A and B are contiguous
+    };
+    mcp23018_configure_iocon(dev, &iocon);
+
+    uint8_t port_a = input_mask & 0xFF;
+    uint8_t port_b = input_mask >> 8;
+
+    // IODIRA..INTCONB are adjacent in BANK=0, written in one sequential transfer
+    uint8_t regs[] = {
+        port_a, port_b,     // IODIR: sensor pins are inputs
+        0x00, 0x00,         // IPOL: no inversion, handled per sensor
+        port_a, port_b,     // GPINTEN: interrupt only on sensor pins
+        0x00, 0x00,         // DEFVAL: unused in previous-value mode
+        0x00, 0x00,         // INTCON: compare against previous value (edge detection)
+    };
+    int res = mcp23018_write_regs(dev, MCP23018_IODIRA, regs, sizeof(regs));
+    if (res < 0) {
+        printf("Failed to configure MCP23018 at 0x%02x (error: %d)\n", dev->addr, res);
+    }
+    return res;
+}
+
+int mcp23018_restore(mcp23018_t *dev) {
+    uint64_t start_us = time_us_64();
+
+    // 0x00..0x15 in one sequential write. After a reset the chip is in BANK=0 with
+    // SEQOP=0, and the IOCON byte in the middle keeps it that way. INTF/INTCAP
+    // writes are ignored by the chip, the GPIO bytes carry the OLAT values.
+    uint8_t image[MCP23018_REG_COUNT];
+    memcpy(image, dev->shadow, sizeof(image));
+    image[MCP23018_GPIOA] = dev->shadow[MCP23018_OLATA];
+    image[MCP23018_GPIOB] = dev->shadow[MCP23018_OLATB];
+
+    int res = i2c_async_write_blocking(dev->addr, MCP23018_IODIRA, image, sizeof(image));
+    if (res < 0) {
+        printf("MCP23018 0x%02x: configuration replay failed (error: %d)\n", dev->addr, res);
         return res;
     }
 
-    //printf("DEBUG: Reading from device 0x%02x, register 0x%02x\n", EXPANDER_ADDR, reg);
-    res = i2c_read_blocking(i2c_default, EXPANDER_ADDR, data, 1, false);
-    //printf("DEBUG: Read result: %d, data: 0x%02x\n", res, *data);
-    
+    // Verify with one burst read of the same range. This also reads INTCAP, which
+    // clears anything latched during the replay.
+    uint8_t readback[MCP23018_REG_COUNT];
+    res = i2c_async_read_blocking(dev->addr, MCP23018_IODIRA, readback, sizeof(readback));
+    if (res != sizeof(readback)) {
+        printf("MCP23018 0x%02x: configuration read-back failed (error: %d)\n", dev->addr, res);
+        return res < 0 ? res : PICO_ERROR_GENERIC;
+    }
+    for (uint8_t reg = 0; reg < MCP23018_REG_COUNT; reg++) {
+        if (is_config_reg(reg) && readback[reg] != dev->shadow[reg]) {
+            printf("MCP23018 0x%02x: register 0x%02x reads 0x%02x, expected 0x%02x\n",
+                   dev->addr, reg, readback[reg], dev->shadow[reg]);
+            return PICO_ERROR_GENERIC;
+        }
+    }
+
+    dev->restore_count++;
+    dev->last_restore_us = (uint32_t)(time_us_64() - start_us);
+    return 0;
+}
+
+bool mcp23018_probe(const mcp23018_t *dev) {
+    uint8_t iocon;
+    if (i2c_async_read_blocking(dev->addr, MCP23018_IOCON, &iocon, 1) != 1) return false;
+    // A chip that answers with a different IOCON has been reset behind our back
+    return iocon == dev->shadow[MCP23018_IOCON];
+}
+
+uint8_t mcp23018_shadow_get(const mcp23018_t *dev, uint8_t reg) {
+    return reg < MCP23018_REG_COUNT ? dev->shadow[reg] : 0;
+}
+
+// Blocking register access, runs through the async engine and sleeps with __wfe()
+// while the transfer is on the wire. Use the _async variants from the main loop.
+int mcp23018_read8(const mcp23018_t *dev, uint8_t reg, uint8_t *data) {
+    // Configuration comes from the shadow, only INTF/INTCAP/GPIO need the bus
+    if (is_config_reg(reg) || reg == MCP23018_IOCON + 1) {
+        *data = dev->shadow[reg];
+        return 1;
+    }
+    int res = i2c_async_read_blocking(dev->addr, reg, data, 1);
     if (res < 1) {
         printf("DEBUG: Read error code: %d\n", res);
     }
-    
     return res;
 }
 
-int mcp23018_store8(uint8_t reg, uint8_t data) {
-    // Use the 7-bit address directly - Pico SDK handles R/W bit
-    int res;
+int mcp23018_store8(mcp23018_t *dev, uint8_t reg, uint8_t data) {
+    return mcp23018_write_regs(dev, reg, &data, 1);
+}
 
-    uint8_t buf[2];
-    buf[0] = reg;
-    buf[1] = data;
-    res = i2c_write_blocking(i2c_default, EXPANDER_ADDR, buf, 2, false);
+bool mcp23018_read_async(const mcp23018_t *dev, uint8_t reg, uint8_t *data, uint8_t len, i2c_async_cb_t cb, void *user_data) {
+    return i2c_async_read(dev->addr, reg, data, len, cb, user_data);
+}
 
-    return res;
+bool mcp23018_write_async(const mcp23018_t *dev, uint8_t reg, const uint8_t *data, uint8_t len, i2c_async_cb_t cb, void *user_data) {
+    return i2c_async_write(dev->addr, reg, data, len, cb, user_data);
 }
 
-// I2C bus reset - sends 9 clock pulses to clear any stuck slaves
-void mcp23018_i2c_bus_reset(void) {
-    printf("Performing I2C bus reset...\n");
-    
-    // Deinitialize I2C to manually control pins
-    i2c_deinit(i2c_default);
-    
-    // Configure SDA and SCL as GPIO outputs
-    gpio_init(I2C_SDA_PIN);
-    gpio_init(I2C_SCL_PIN);
-    gpio_set_dir(I2C_SDA_PIN, GPIO_OUT);
-    gpio_set_dir(I2C_SCL_PIN, GPIO_OUT);
-    
-    // Set both high
-    gpio_put(I2C_SDA_PIN, 1);
-    gpio_put(I2C_SCL_PIN, 1);
-    sleep_us(10);
-    
-    // Send 9 clock pulses to clear any stuck transaction
-    for (int i = 0; i < 9; i++) {
-        gpio_put(I2C_SCL_PIN, 0);
-        sleep_us(5);
-        gpio_put(I2C_SCL_PIN, 1);
-        sleep_us(5);
-    }
-    
-    // Send STOP condition
-    gpio_put(I2C_SDA_PIN, 0);
-    sleep_us(5);
-    gpio_put(I2C_SCL_PIN, 1);
-    sleep_us(5);
-    gpio_put(I2C_SDA_PIN, 1);
-    sleep_us(10);
-    
-    // Reinitialize I2C
-    i2c_init(i2c_default, 100 * 1000);
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_disable_pulls(I2C_SDA_PIN);
-    gpio_disable_pulls(I2C_SCL_PIN);
-    
-    printf("I2C bus reset complete\n");
+bool mcp23018_read_interrupt_async(const mcp23018_t *dev, mcp23018_int_capture_t *capture, i2c_async_cb_t cb, void *user_data) {
+    return i2c_async_read(dev->addr, MCP23018_INTFA, (uint8_t *)capture, sizeof(*capture), cb, user_data);
 }
 
 // Hardware reset using RESET pin - much more reliable than I2C bus reset
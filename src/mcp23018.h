@@ -3,6 +3,7 @@
 
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "i2c_async.h"
 
 #define GPA7_PIN (1 << 7)
 #define GPA6_PIN (1 << 6)
@@ -13,24 +14,116 @@
 #define GPA1_PIN (1 << 1)
 #define GPA0_PIN (1 << 0)
 
+// 16-bit pin masks cover both ports: bits 0-7 = GPA0-GPA7, bits 8-15 = GPB0-GPB7
+#define GPB7_PIN (1 << 15)
+#define GPB6_PIN (1 << 14)
+#define GPB5_PIN (1 << 13)
+#define GPB4_PIN (1 << 12)
+#define GPB3_PIN (1 << 11)
+#define GPB2_PIN (1 << 10)
+#define GPB1_PIN (1 << 9)
+#define GPB0_PIN (1 << 8)
+
+#define MCP23018_PIN_COUNT 16
+// Address is set by the ADDR pin voltage, 0x20-0x27
+#define MCP23018_MAX_DEVICES 8
+
+// MCP23018 register addresses (IOCON.BANK=0, ports A/B interleaved).
+// BANK=0 keeps INTF, INTCAP and GPIO of both ports adjacent, so one sequential
+// read starting at INTFA returns all six in a single transaction.
+#define MCP23018_IODIRA     0x00
+#define MCP23018_IODIRB     0x01
+#define MCP23018_IPOLA      0x02
+#define MCP23018_IPOLB      0x03
+#define MCP23018_GPINTENA   0x04
+#define MCP23018_GPINTENB   0x05
+#define MCP23018_DEFVALA    0x06
+#define MCP23018_DEFVALB    0x07
+#define MCP23018_INTCONA    0x08
+#define MCP23018_INTCONB    0x09
+#define MCP23018_IOCON      0x0A
+#define MCP23018_GPPUA      0x0C
+#define MCP23018_GPPUB      0x0D
+#define MCP23018_INTFA      0x0E
+#define MCP23018_INTFB      0x0F
+#define MCP23018_INTCAPA    0x10
+#define MCP23018_INTCAPB    0x11
+#define MCP23018_GPIOA      0x12
+#define MCP23018_GPIOB      0x13
+#define MCP23018_OLATA      0x14
+#define MCP23018_OLATB      0x15
+
+#define MCP23018_REG_COUNT  0x16
+
+// IOCON address while the chip is in BANK=1 (e.g. after a warm reboot without reset)
+#define MCP23018_IOCON_BANK1 0x05
+
+// One expander on the bus
+typedef struct {
+    uint8_t addr;       // 7-bit I2C address
+    uint8_t int_pin;    // Pico GPIO connected to INTA (INTB is mirrored onto it)
+    bool shared_int;    // INTA wired-OR with other expanders on the same GPIO
+    uint8_t shadow[MCP23018_REG_COUNT]; // last configured value of every register (BANK=0 addresses)
+    uint16_t restore_count;             // successful mcp23018_restore() calls
+    uint32_t last_restore_us;           // duration of the last replay + verify
+} mcp23018_t;
+
+// Result of mcp23018_read_interrupt_async(), in register order starting at INTFA
+typedef struct {
+    uint8_t intfa;
+    uint8_t intfb;
+    uint8_t intcapa;
+    uint8_t intcapb;
+    uint8_t gpioa;
+    uint8_t gpiob;
+} mcp23018_int_capture_t;
+
+// Both ports of a capture as 16-bit pin masks
+static inline uint16_t mcp23018_capture_intf(const mcp23018_int_capture_t *capture) {
+    return (uint16_t)(capture->intfa | (capture->intfb << 8));
+}
+
+static inline uint16_t mcp23018_capture_intcap(const mcp23018_int_capture_t *capture) {
+    return (uint16_t)(capture->intcapa | (capture->intcapb << 8));
+}
+
 // IOCON register bit structure
 typedef struct {
     uint8_t INTCC : 1;    // bit 0: Interrupt Clearing Control
     uint8_t INTPOL : 1;   // bit 1: GPIO Register bit polarity
-    uint8_t reserved1 : 1; // bit 2: reserved (0)
+    uint8_t ODR : 1;      // bit 2: INT pin open-drain (overrides INTPOL)
     uint8_t reserved2 : 1; // bit 3: reserved (0)
     uint8_t reserved3 : 1; // bit 4: reserved (0)
-    uint8_t SEQOP : 1;    // bit 5: Sequential Operation mode
+    uint8_t SEQOP : 1;    // bit 5: Sequential Operation mode (0 = address pointer increments)
     uint8_t MIRROR : 1;   // bit 6: INT Pins Mirror bit
     uint8_t BANK : 1;     // bit 7: Controls how registers are addressed
 } mcp23018_iocon_t;
 
 // Function declarations
-void mcp23018_init(i2c_inst_t *i2c, uint8_t addr);
-void mcp23018_configure_iocon(i2c_inst_t *i2c, uint8_t addr, mcp23018_iocon_t *iocon);
-int mcp23018_read8(uint8_t reg, uint8_t *data);
-int mcp23018_store8(uint8_t reg, uint8_t data);
-void mcp23018_i2c_bus_reset(void);
+// Sets up the device struct with a power-on shadow, no bus access
+void mcp23018_init(mcp23018_t *dev, uint8_t addr, uint8_t int_pin);
+void mcp23018_configure_iocon(mcp23018_t *dev, mcp23018_iocon_t *iocon);
+// IOCON for interrupt capture plus direction and interrupt enables for both ports.
+// input_mask is a 16-bit pin mask, pins outside it are left as outputs.
+int mcp23018_configure_inputs(mcp23018_t *dev, uint16_t input_mask);
+// Replays the shadow in one sequential write and verifies it with one burst read.
+// Use after a hardware reset or bus recovery. Returns 0 or a PICO_ERROR_* code.
+int mcp23018_restore(mcp23018_t *dev);
+// Reads IOCON over the bus, true if the chip answers with the configured value
+bool mcp23018_probe(const mcp23018_t *dev);
+uint8_t mcp23018_shadow_get(const mcp23018_t *dev, uint8_t reg);
+// Configuration registers are served from the shadow without a bus transfer
+int mcp23018_read8(const mcp23018_t *dev, uint8_t reg, uint8_t *data);
+// Writes go to the chip and, once acknowledged, into the shadow
+int mcp23018_store8(mcp23018_t *dev, uint8_t reg, uint8_t data);
+int mcp23018_write_regs(mcp23018_t *dev, uint8_t reg, const uint8_t *data, uint8_t len);
+// Queued register access, cb runs in I2C IRQ context when the transfer finishes
+bool mcp23018_read_async(const mcp23018_t *dev, uint8_t reg, uint8_t *data, uint8_t len, i2c_async_cb_t cb, void *user_data);
+// Does not update the shadow, use for output/latch traffic only
+bool mcp23018_write_async(const mcp23018_t *dev, uint8_t reg, const uint8_t *data, uint8_t len, i2c_async_cb_t cb, void *user_data);
+// INTF, INTCAP and GPIO of both ports in one sequential burst (needs BANK=0, SEQOP=0)
+bool mcp23018_read_interrupt_async(const mcp23018_t *dev, mcp23018_int_capture_t *capture, i2c_async_cb_t cb, void *user_data);
+// The RESET line is shared, this resets every expander on the bus
 void mcp23018_hardware_reset(void);
 
 #endif // MCP23018_H
\ No newline at end of file
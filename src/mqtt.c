@@ -8,8 +8,14 @@
 #include "lwip/apps/mqtt_priv.h" // needed to set hostname
 #include "lwip/dns.h"
 #include "lwip/altcp_tls.h"
+#if LWIP_ALTCP && LWIP_ALTCP_TLS
+#include "mbedtls/ssl.h"
+#endif
+#include "tls_heap.h"
+#include "mqtt_queue.h"
 #include "main.h"
 #include "alarm.h"
+#include "events.h"
 
 // This file includes your client certificate for client server authentication
 #ifdef MQTT_CERT_INC
@@ -19,6 +25,54 @@
 mqtt_flags_t mqtt_flags = {0};
 static alarm_context_t *g_alarm_ctx = NULL;
 
+static payload_format_t payload_format = MQTT_PAYLOAD_FORMAT_DEFAULT;
+// Set on every connect and format change, cleared once the retained flag is queued
+static volatile bool format_announce_pending = false;
+// Set on every connect, cleared once the current alarm state is queued ahead of the replay
+static volatile bool alarm_announce_pending = false;
+// Set on every connect, cleared once the retained online flag is queued
+static volatile bool online_announce_pending = false;
+static mqtt_payload_stats_t payload_stats[MQTT_PAYLOAD_KIND_COUNT][PAYLOAD_FORMAT_COUNT];
+
+// Commands are copied out of the lwIP buffer into a small slot array and the
+// slot's sequence number travels through EVENT_RING_NETWORK to the main loop.
+// seq works like a seqlock: it reads COMMAND_SLOT_WRITING while the text is being
+// replaced, so the reader can tell a torn copy from a good one.
+#define COMMAND_SLOT_WRITING UINT32_MAX
+
+typedef struct {
+    volatile uint32_t seq;
+    char json[MQTT_COMMAND_MAX_LEN];
+} mqtt_command_slot_t;
+
+static mqtt_command_slot_t command_slots[MQTT_COMMAND_SLOTS];
+static uint32_t command_seq = 0;
+
+
+static mqtt_tls_stats_t tls_stats;
+static uint64_t connect_started_us;
+
+#if LWIP_ALTCP && LWIP_ALTCP_TLS
+// Session of the last successful connection, offered to the broker on reconnect.
+// A resumed handshake skips the certificate exchange, so no certificate gets verified.
+// The session ID cannot tell: with a ticket mbedtls sends a fresh random ID (RFC 5077 3.4).
+static struct altcp_tls_session *tls_session = NULL;
+static bool tls_session_valid = false;
+static bool tls_resume_offered = false;
+static uint32_t tls_certs_verified = 0;
+
+// Called for each certificate of the broker's chain, leaves the verification result as is
+static int tls_count_verify(void *arg, mbedtls_x509_crt *crt, int depth, uint32_t *flags) {
+    tls_certs_verified++;
+    return 0;
+}
+#endif
+
+// lwIP callbacks, registered in mqtt_start_connect()
+static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status);
+static void mqtt_incoming_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags);
+static void mqtt_incoming_publish_cb(void *arg, const char *topic, u32_t tot_len);
+
 MQTT_CLIENT_DATA_T* mqtt_init() {
     MQTT_CLIENT_DATA_T* mqtt=(MQTT_CLIENT_DATA_T*)calloc(1, sizeof(MQTT_CLIENT_DATA_T));
     if (!mqtt) {
@@ -27,16 +81,14 @@ MQTT_CLIENT_DATA_T* mqtt_init() {
     }
 
     static char client_id_buffer[32];
-    static char will_topic_buffer[64];
     strncpy(client_id_buffer, MQTT_CLIENT_ID, sizeof(client_id_buffer) - 1);
     client_id_buffer[sizeof(client_id_buffer) - 1] = '\0';
-    
-    snprintf(will_topic_buffer, sizeof(will_topic_buffer), MQTT_FULL_TOPIC_HEARTBEAT);
-    will_topic_buffer[sizeof(will_topic_buffer) - 1] = '\0';
 
     mqtt->mqtt_client_info.client_id = client_id_buffer;
     mqtt->mqtt_client_info.keep_alive = MQTT_KEEP_ALIVE_S;
     mqtt->newTopic=false;
+    mqtt_queue_init();
+    topics_init();
     #if defined(MQTT_USERNAME) && defined(MQTT_PASSWORD)
         mqtt->mqtt_client_info.client_user = MQTT_USERNAME;
         mqtt->mqtt_client_info.client_pass = MQTT_PASSWORD;
@@ -44,7 +96,7 @@ MQTT_CLIENT_DATA_T* mqtt_init() {
         mqtt->mqtt_client_info.client_user = NULL;
         mqtt->mqtt_client_info.client_pass = NULL;
     #endif
-        mqtt->mqtt_client_info.will_topic = will_topic_buffer;
+        mqtt->mqtt_client_info.will_topic = topics_get(TOPIC_HEARTBEAT);
         mqtt->mqtt_client_info.will_msg = MQTT_WILL_MSG;
         mqtt->mqtt_client_info.will_qos = MQTT_WILL_QOS;
         mqtt->mqtt_client_info.will_retain = true;
@@ -71,6 +123,8 @@ MQTT_CLIENT_DATA_T* mqtt_init() {
         mqtt->mqtt_client_info.tls_config = altcp_tls_create_config_client(NULL, 0);
         WARN_printf("Warning: tls without a certificate is insecure\n");
     #endif
+        // Only now: creating the config installs lwIP's own mbedtls allocator
+        tls_heap_init();
     #else
         printf("Not using TLS\n");
     #endif
@@ -78,45 +132,104 @@ MQTT_CLIENT_DATA_T* mqtt_init() {
     return mqtt;
 }
 
-int mqtt_connect(MQTT_CLIENT_DATA_T* mqtt_ctx, char* broker_ip) {
-    
-    // We are not in a callback so locking is needed when calling lwip
-    // Make a DNS request for the MQTT server IP address
-    cyw43_arch_lwip_begin();
-    int err = dns_gethostbyname(MQTT_SERVER, &mqtt_ctx->mqtt_server_address, dns_found, mqtt_ctx);
-    cyw43_arch_lwip_end();
-    mqtt_ctx->mqtt_client_inst = mqtt_client_new();
-    
+bool mqtt_start_connect(MQTT_CLIENT_DATA_T* mqtt_ctx) {
+    // The client instance is reused, lwIP resets it to disconnected when a connection closes
     if (!mqtt_ctx->mqtt_client_inst) {
-        printf("mqtt client inst error\n");
-        return -1;
+        mqtt_ctx->mqtt_client_inst = mqtt_client_new();
+        if (!mqtt_ctx->mqtt_client_inst) {
+            printf("mqtt client inst error\n");
+            return false;
+        }
     }
 
     printf("IP address of this device %s\n", ipaddr_ntoa(&(netif_list->ip_addr)));
     printf("Connecting to mqtt server at %s\n", ipaddr_ntoa(&mqtt_ctx->mqtt_server_address));
-    
-    if (err == ERR_OK) {
-        cyw43_arch_lwip_begin();
-
-        err_t mqtt_err = mqtt_client_connect(mqtt_ctx->mqtt_client_inst, &mqtt_ctx->mqtt_server_address, MQTT_BROKER_PORT, mqtt_connection_cb, mqtt_ctx, &mqtt_ctx->mqtt_client_info);
-        if (err != ERR_OK) {
-            printf("mqtt_client_connect failed: %d\n", err);
-            cyw43_arch_lwip_end();
-            return -1;
-        }
-    }
 
+    cyw43_arch_lwip_begin();
+    err_t err = mqtt_client_connect(mqtt_ctx->mqtt_client_inst, &mqtt_ctx->mqtt_server_address, MQTT_BROKER_PORT,
+                                    mqtt_connection_cb, mqtt_ctx, &mqtt_ctx->mqtt_client_info);
+    if (err != ERR_OK) {
+        printf("mqtt_client_connect failed: %d\n", err);
+        cyw43_arch_lwip_end();
+        return false;
+    }
 
 #if LWIP_ALTCP && LWIP_ALTCP_TLS
     // This is important for MBEDTLS_SSL_SERVER_NAME_INDICATION
     mbedtls_ssl_set_hostname(altcp_tls_context(mqtt_ctx->mqtt_client_inst->conn), MQTT_SERVER);
     printf("TLS hostname set to: %s\n", MQTT_SERVER);
+    tls_certs_verified = 0;
+    mbedtls_ssl_set_verify(altcp_tls_context(mqtt_ctx->mqtt_client_inst->conn), tls_count_verify, NULL);
+
+    // Must be set before the TCP connection completes and the handshake starts
+    tls_resume_offered = tls_session_valid &&
+                         altcp_tls_set_session(mqtt_ctx->mqtt_client_inst->conn, tls_session) == ERR_OK;
+    if (tls_resume_offered) {
+        tls_stats.resume_offered++;
+    }
 #endif
 
     mqtt_set_inpub_callback(mqtt_ctx->mqtt_client_inst, mqtt_incoming_publish_cb, mqtt_incoming_data_cb, mqtt_ctx);
     cyw43_arch_lwip_end();
 
-    return 0;
+    mqtt_ctx->reconnect_attempts++;
+    mqtt_ctx->last_reconnect_attempt = to_ms_since_boot(get_absolute_time());
+    connect_started_us = time_us_64();
+    tls_heap_reset_peak();
+    return true;
+}
+
+static void record_connect_time(mqtt_connect_timing_t *timing) {
+    uint32_t elapsed_ms = (uint32_t)((time_us_64() - connect_started_us) / 1000);
+    timing->count++;
+    timing->last_ms = elapsed_ms;
+    timing->total_ms += elapsed_ms;
+    if (elapsed_ms > timing->max_ms) timing->max_ms = elapsed_ms;
+    if (tls_heap_peak() > timing->heap_peak) timing->heap_peak = tls_heap_peak();
+}
+
+// lwIP context, right after CONNACK. Classifies the handshake and keeps the
+// session for the next reconnect.
+static void mqtt_tls_connected(mqtt_client_t *client) {
+#if LWIP_ALTCP && LWIP_ALTCP_TLS
+    mbedtls_ssl_context *ssl = (mbedtls_ssl_context *)altcp_tls_context(client->conn);
+    const mbedtls_ssl_session *session = ssl ? ssl->session : NULL;
+
+    bool resumed = tls_resume_offered && tls_certs_verified == 0;
+    record_connect_time(resumed ? &tls_stats.resumed : &tls_stats.full);
+
+    if (!tls_session) {
+        tls_session = altcp_tls_alloc_session();
+    }
+    tls_session_valid = tls_session && session && altcp_tls_get_session(client->conn, tls_session) == ERR_OK;
+    if (tls_session_valid) {
+        tls_stats.session_saves++;
+    }
+#else
+    record_connect_time(&tls_stats.full);
+#endif
+}
+
+const mqtt_tls_stats_t* mqtt_get_tls_stats(void) {
+    return &tls_stats;
+}
+
+void mqtt_print_tls_stats(void) {
+    const mqtt_connect_timing_t *full = &tls_stats.full;
+    const mqtt_connect_timing_t *resumed = &tls_stats.resumed;
+    printf("MQTT connect: full n=%lu avg=%lums max=%lums heap %lu B, resumed n=%lu avg=%lums max=%lums heap %lu B, "
+           "%lu resumes offered, %lu sessions saved, TLS heap in use %lu B\n",
+           full->count, full->count ? full->total_ms / full->count : 0, full->max_ms, full->heap_peak,
+           resumed->count, resumed->count ? resumed->total_ms / resumed->count : 0, resumed->max_ms, resumed->heap_peak,
+           tls_stats.resume_offered, tls_stats.session_saves, tls_heap_in_use());
+}
+
+void mqtt_abort_connect(MQTT_CLIENT_DATA_T* mqtt_ctx) {
+    if (!mqtt_ctx->mqtt_client_inst) return;
+    cyw43_arch_lwip_begin();
+    mqtt_disconnect(mqtt_ctx->mqtt_client_inst);
+    cyw43_arch_lwip_end();
+    mqtt_ctx->connect_done = false;
 }
 
 void mqtt_request_cb(void *arg, err_t err) {
@@ -129,130 +242,196 @@ void mqtt_request_cb(void *arg, err_t err) {
 
 static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status) {
     MQTT_CLIENT_DATA_T *mqtt_client = (MQTT_CLIENT_DATA_T *)arg;
-    LWIP_UNUSED_ARG(client);
 
     LWIP_PLATFORM_DIAG(("MQTT client \"%s\" connection cb: status %d\n", mqtt_client->mqtt_client_info.client_id, (int)status));
 
     if (status == MQTT_CONNECT_ACCEPTED) {
         printf("MQTT connected!\n");
         mqtt_client->connect_done = true;
-        mqtt_client->reconnect_needed = false;
         mqtt_client->reconnect_attempts = 0;
-        // Indicate online
-        if(mqtt_client->mqtt_client_info.will_topic) {
-            mqtt_publish(mqtt_client->mqtt_client_inst, mqtt_client->mqtt_client_info.will_topic, "1", 1, MQTT_WILL_QOS, true, mqtt_request_cb, mqtt_client);
-        }
+        mqtt_tls_connected(client);
+        format_announce_pending = true;
+        alarm_announce_pending = true;
+        // Indicate online, queued from the main loop like every other publish
+        online_announce_pending = mqtt_client->mqtt_client_info.will_topic != NULL;
 
-        char cmd_topic[128];
-        snprintf(cmd_topic, sizeof(cmd_topic), "%s/%s/cmd", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-        mqtt_sub_unsub(mqtt_client->mqtt_client_inst, cmd_topic, MQTT_SUBSCRIBE_QOS, mqtt_request_cb, mqtt_client, 1);
+        mqtt_sub_unsub(mqtt_client->mqtt_client_inst, topics_get(TOPIC_COMMAND), MQTT_SUBSCRIBE_QOS, mqtt_request_cb, mqtt_client, 1);
         // mqtt_sub_unsub(client, "sensor/commands", 0, mqtt_request_cb, arg, 1);
         // mqtt_sub_unsub(client, "sensor/arm", 0, mqtt_request_cb, arg, 1);
         // mqtt_sub_unsub(client, "sensor/disarm", 0, mqtt_request_cb, arg, 1);
-    } else if (status == MQTT_CONNECT_DISCONNECTED) {
-        printf("MQTT disconnected \n");
+        events_push(EVENT_RING_NETWORK, HUB_EVENT_MQTT_CONNECTION, 0, 1, status);
+    } else {
+        // Disconnect, refusal or timeout, the network state machine schedules the retry
+        printf("MQTT disconnected (status %d)\n", (int)status);
+#if LWIP_ALTCP && LWIP_ALTCP_TLS
+        if (!mqtt_client->connect_done && tls_resume_offered) {
+            // Failed before CONNACK with a resumed session, start the next attempt clean
+            tls_session_valid = false;
+        }
+#endif
         mqtt_client->connect_done = false;
         mqtt_client->last_disconnect_time = to_ms_since_boot(get_absolute_time());
-        mqtt_client->reconnect_needed = true;
+        events_push(EVENT_RING_NETWORK, HUB_EVENT_MQTT_CONNECTION, 0, 0, status);
     }
 }
 
-bool mqtt_attempt_reconnect(MQTT_CLIENT_DATA_T* mqtt_ctx) {
-    uint32_t now = to_ms_since_boot(get_absolute_time());
-    
-    // Don't attempt reconnection too frequently
-    if (now - mqtt_ctx->last_reconnect_attempt < 5000) {  // Wait 5 seconds between attempts
-        return false;
-    }
-    
-    mqtt_ctx->last_reconnect_attempt = now;
-    mqtt_ctx->reconnect_attempts++;
-    
-    printf("MQTT reconnection attempt #%lu\n", mqtt_ctx->reconnect_attempts);
-    
-    // Clean up old client instance
-    if (mqtt_ctx->mqtt_client_inst) {
-        mqtt_disconnect(mqtt_ctx->mqtt_client_inst);
-        // Note: lwIP MQTT doesn't have explicit free function, memory is managed by lwIP
-        mqtt_ctx->mqtt_client_inst = NULL;
-    }
-    
-    // Create new client instance
-    mqtt_ctx->mqtt_client_inst = mqtt_client_new();
-    if (!mqtt_ctx->mqtt_client_inst) {
-        printf("Failed to create new MQTT client instance\n");
-        return false;
+static void mqtt_incoming_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags) {
+    MQTT_CLIENT_DATA_T* mqtt_client = (MQTT_CLIENT_DATA_T*)arg;
+    LWIP_UNUSED_ARG(flags);
+
+    if (len >= sizeof(mqtt_client->data)) {
+        len = sizeof(mqtt_client->data) - 1;
     }
-    
-    // Attempt connection
-    cyw43_arch_lwip_begin();
-    err_t err = mqtt_client_connect(mqtt_ctx->mqtt_client_inst, &mqtt_ctx->mqtt_server_address, 
-                                   MQTT_BROKER_PORT, mqtt_connection_cb, mqtt_ctx, 
-                                   &mqtt_ctx->mqtt_client_info);
-    
-    if (err != ERR_OK) {
-        printf("MQTT reconnection failed: %d\n", err);
-        cyw43_arch_lwip_end();
-        return false;
+    memcpy(mqtt_client->data, data, len);
+    mqtt_client->len=len;
+    mqtt_client->data[len]='\0';
+ 
+    // The topic was matched once in mqtt_incoming_publish_cb, not per data fragment
+    if (mqtt_client->topic_id == TOPIC_COMMAND) {
+        // Commands touch the alarm state machine, so they run in the main loop
+        if (command_seq == COMMAND_SLOT_WRITING) command_seq = 0;
+        mqtt_command_slot_t *slot = &command_slots[command_seq % MQTT_COMMAND_SLOTS];
+        slot->seq = COMMAND_SLOT_WRITING;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        strncpy(slot->json, (const char *)mqtt_client->data, sizeof(slot->json) - 1);
+        slot->json[sizeof(slot->json) - 1] = '\0';
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->seq = command_seq;
+        if (!events_push(EVENT_RING_NETWORK, HUB_EVENT_MQTT_COMMAND, 0, 0, command_seq)) {
+            printf("Network event ring full, command dropped\n");
+        }
+        command_seq++;
     }
-    
-    #if LWIP_ALTCP && LWIP_ALTCP_TLS
-    // Reset TLS hostname for new connection
-    mbedtls_ssl_set_hostname(altcp_tls_context(mqtt_ctx->mqtt_client_inst->conn), MQTT_SERVER);
-    #endif
-    
-    mqtt_set_inpub_callback(mqtt_ctx->mqtt_client_inst, mqtt_incoming_publish_cb, mqtt_incoming_data_cb, mqtt_ctx);
-    cyw43_arch_lwip_end();
-    
-    printf("MQTT reconnection initiated\n");
-    return true;
 }
 
-void mqtt_handle_reconnection(MQTT_CLIENT_DATA_T *mqtt_ctx) {
-    if(!mqtt_ctx->reconnect_needed) return;
+// Runs in the main loop for HUB_EVENT_MQTT_COMMAND records
+void mqtt_process_command(MQTT_CLIENT_DATA_T* mqtt_ctx, const event_record_t *event) {
+    if (!g_alarm_ctx) return;
+
+    mqtt_command_slot_t *slot = &command_slots[event->data % MQTT_COMMAND_SLOTS];
+    char command_json[MQTT_COMMAND_MAX_LEN];
+
+    // The slot may be reused if more than MQTT_COMMAND_SLOTS commands arrive before the
+    // loop gets to this one, even while it is being copied: seq must match before and after
+    uint32_t seq_before = slot->seq;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    memcpy(command_json, slot->json, sizeof(command_json));
+    command_json[sizeof(command_json) - 1] = '\0';
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
 
-    // Check if we have TCP/IP connectivity first
-    int link_status = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
-    if (link_status != CYW43_LINK_UP) {
-        printf("No TCP/IP connectivity (status: %d), cannot reconnect MQTT\n", link_status);
+    if (seq_before != event->data || slot->seq != event->data) {
+        printf("Command #%lu was overwritten before it could be processed\n", event->data);
         return;
     }
 
-    // exponential backoff with capped at 1 minute
-    uint32_t backoff_time = 5000;
-    if(mqtt_ctx->reconnect_attempts > 1) {
-        backoff_time = 5000 << (mqtt_ctx->reconnect_attempts - 1);
-        if (backoff_time > 60000) {
-            backoff_time = 60000;
+    printf("Command received on topic %s: %s\n", MQTT_FULL_TOPIC_COMMAND, command_json);
+    mqtt_handle_command(mqtt_ctx, g_alarm_ctx, command_json);
+}
+
+void mqtt_set_payload_format(payload_format_t format) {
+    if (format >= PAYLOAD_FORMAT_COUNT) return;
+    payload_format = format;
+    format_announce_pending = true;
+}
+
+payload_format_t mqtt_get_payload_format(void) {
+    return payload_format;
+}
+
+const char* mqtt_payload_format_to_string(payload_format_t format) {
+    switch (format) {
+        case PAYLOAD_FORMAT_JSON: return "json";
+        case PAYLOAD_FORMAT_CBOR: return "cbor";
+        default: return "unknown";
+    }
+}
+
+payload_format_t mqtt_payload_format_from_string(const char *name) {
+    for (int i = 0; i < PAYLOAD_FORMAT_COUNT; i++) {
+        if (strcmp(name, mqtt_payload_format_to_string((payload_format_t)i)) == 0) return (payload_format_t)i;
+    }
+    return PAYLOAD_FORMAT_COUNT;
+}
+
+const mqtt_payload_stats_t* mqtt_get_payload_stats(mqtt_payload_kind_t kind, payload_format_t format) {
+    if (kind >= MQTT_PAYLOAD_KIND_COUNT || format >= PAYLOAD_FORMAT_COUNT) return NULL;
+    return &payload_stats[kind][format];
+}
+
+void mqtt_print_payload_stats(void) {
+    static const char *const kind_names[MQTT_PAYLOAD_KIND_COUNT] = { "door", "alarm", "heartbeat" };
+
+    printf("Payloads (%s selected):\n", mqtt_payload_format_to_string(payload_format));
+    for (int kind = 0; kind < MQTT_PAYLOAD_KIND_COUNT; kind++) {
+        for (int format = 0; format < PAYLOAD_FORMAT_COUNT; format++) {
+            const mqtt_payload_stats_t *stats = &payload_stats[kind][format];
+            if (stats->count == 0) continue;
+            // time_us_64() has 1 us resolution, so the average is shown to a tenth of that
+            uint32_t encode_tenths = (uint32_t)((uint64_t)stats->total_encode_us * 10 / stats->count);
+            printf("  %-9s %s: n=%lu last=%luB avg=%luB encode avg=%lu.%luus\n",
+                   kind_names[kind],
+                   mqtt_payload_format_to_string((payload_format_t)format),
+                   stats->count,
+                   stats->last_bytes,
+                   stats->total_bytes / stats->count,
+                   encode_tenths / 10, encode_tenths % 10);
         }
     }
+}
 
-    uint32_t now = to_ms_since_boot(get_absolute_time());
-    if(now - mqtt_ctx->last_reconnect_attempt < backoff_time) {
+// Called after a successful mqtt_queue_commit(), json->len is the payload size
+static void record_payload(mqtt_payload_kind_t kind, const json_writer_t *json, uint64_t started_us) {
+    mqtt_payload_stats_t *stats = &payload_stats[kind][json->format];
+    stats->count++;
+    stats->last_bytes = json->len;
+    stats->total_bytes += json->len;
+    stats->total_encode_us += (uint32_t)(time_us_64() - started_us);
+}
+
+// The journal only holds transitions, so after an outage the broker's retained alarm
+// state can be older than the replay that is about to follow. Publish the live state
+// first on the ALARM lane; transient states are skipped, their outcome is a transition.
+static void publish_current_alarm_state(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm_ctx) {
+    alarm_state_t state = alarm_ctx->current_state;
+    if (state == ALARM_STATE_ARMING || state == ALARM_STATE_TRIGGERING) {
+        alarm_announce_pending = false;
         return;
     }
+    if (!mqtt_queue_space(MQTT_LANE_ALARM)) return;
+
+    journal_entry_t entry = {
+        .seq = journal_next_seq(),
+        .timestamp_ms = to_ms_since_boot(get_absolute_time()),
+        .kind = JOURNAL_ALARM_STATE,
+        .state = state,
+        .sensor = (uint8_t)sensor_index(alarm_ctx->triggered_sensor),
+    };
+    if (mqtt_publish_alarm_state(mqtt_ctx, MQTT_LANE_ALARM, &entry, false)) {
+        alarm_announce_pending = false;
+    }
+}
+
+// Retained "1" on the will topic, the broker replaces it with the will "0" when we drop
+static void publish_online(MQTT_CLIENT_DATA_T *mqtt_ctx) {
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_STATUS, &json)) return;
+    json_uint(&json, NULL, 1);  // bare root value, the will message is not JSON either
 
-    if(mqtt_attempt_reconnect(mqtt_ctx)){
-        mqtt_ctx->reconnect_needed = false;
+    if (mqtt_queue_commit(MQTT_LANE_STATUS, &json, mqtt_ctx->mqtt_client_info.will_topic, MQTT_WILL_QOS, true)) {
+        online_announce_pending = false;
     }
 }
 
-static void mqtt_incoming_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags) {
-    MQTT_CLIENT_DATA_T* mqtt_client = (MQTT_CLIENT_DATA_T*)arg;
-    LWIP_UNUSED_ARG(data);
- 
-    strncpy(mqtt_client->data, data, len);
-    mqtt_client->len=len;
-    mqtt_client->data[len]='\0';
-    
-    mqtt_client->newTopic=true;
- 
-    char cmd_topic[128];
-    snprintf(cmd_topic, sizeof(cmd_topic), "%s/%s/cmd", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-    
-    if (strcmp(mqtt_client->topic, cmd_topic) == 0 && g_alarm_ctx) {
-        printf("Command received on topic %s: %s\n", mqtt_client->topic, mqtt_client->data);
-        mqtt_handle_command(mqtt_client, g_alarm_ctx, mqtt_client->data);
+// Retained so a consumer subscribing later knows how to decode event payloads
+static void publish_payload_format(void) {
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_EVENT, &json)) return;
+    json_object_begin(&json, NULL);
+    json_string(&json, "format", mqtt_payload_format_to_string(payload_format));
+    json_object_end(&json);
+
+    if (mqtt_queue_commit(MQTT_LANE_EVENT, &json, topics_get(TOPIC_FORMAT), MQTT_PUBLISH_QOS, true)) {
+        format_announce_pending = false;
     }
 }
 
@@ -262,29 +441,27 @@ void mqtt_set_alarm_context(alarm_context_t* alarm_ctx) {
 
 static void mqtt_incoming_publish_cb(void *arg, const char *topic, u32_t tot_len) {
   MQTT_CLIENT_DATA_T* mqtt_client = (MQTT_CLIENT_DATA_T*)arg;
-  strcpy(mqtt_client->topic, topic);
-}
-
-void mqtt_publish_door_state(MQTT_CLIENT_DATA_T *mqtt_ctx, bool door_state, const char *sensor_id) {
-    char topic[100];
-    snprintf(topic, sizeof(topic), "%s/%s/door/%s/%s", SENSOR_ROOT_TOPIC, DEVICE_NAME, sensor_id, door_state ? "open" : "closed");
-
-    char message[50];
-    snprintf(message, sizeof(message), "{\"state\": \"%s\"}", door_state ? "open" : "closed");
-
-    err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, topic, (const u8_t *)message, strlen(message), 0, 0, mqtt_request_cb, mqtt_ctx);
-    if (err != ERR_OK) {
-        printf("mqtt_publish failed: %d\n", err);
-    }
+  mqtt_client->topic_id = (uint8_t)topics_match(topic);
 }
 
-void dns_found(const char *hostname, const ip_addr_t *ipaddr, void *arg) {
-    MQTT_CLIENT_DATA_T *state = (MQTT_CLIENT_DATA_T*)arg;
-    if (ipaddr) {
-        state->mqtt_server_address = *ipaddr;
-    } else {
-        panic("dns request failed");
-    }
+bool mqtt_publish_door_state(MQTT_CLIENT_DATA_T *mqtt_ctx, mqtt_lane_t lane, const journal_entry_t *entry, bool replayed) {
+    const char *topic = topics_door(entry->sensor, entry->state);
+    if (!topic) return true;  // not a door (every door has its topics), consumed
+
+    uint64_t started_us = time_us_64();
+    json_writer_t json;
+    if (!mqtt_queue_begin(lane, &json)) return false;
+    json_set_format(&json, payload_format);
+    json_object_begin(&json, NULL);
+    json_string(&json, "state", entry->state ? "open" : "closed");
+    json_uint(&json, "seq", entry->seq);
+    json_uint(&json, "timestamp", entry->timestamp_ms);
+    if (replayed) json_bool(&json, "replayed", true);
+    json_object_end(&json);
+
+    if (!mqtt_queue_commit(lane, &json, topic, 0, false)) return false;
+    record_payload(MQTT_PAYLOAD_DOOR, &json, started_us);
+    return true;
 }
 
 void mqtt_publish_heartbeat(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm_ctx) {
@@ -295,25 +472,22 @@ void mqtt_publish_heartbeat(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm
 
     uint32_t current_time = to_ms_since_boot(get_absolute_time());
 
-    static char message[512];
-    snprintf(message, sizeof(message), 
-        "{"
-        "\"status\":\"online\","
-        "\"timestamp\":%lu,"
-        "\"uptime_ms\":%lu,"
-        "\"alarm_state\": \"%s\","
-        "\"wifi_connected\":true,"
-        "\"mqtt_connected\":true,"
-        "\"version\":\"1.0.0\""
-        "}",
-        current_time,
-        current_time,
-        alarm_state_to_string(alarm_ctx->current_state)
-    );
-
-    err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, MQTT_FULL_TOPIC_HEARTBEAT, (const u8_t *)message, strlen(message), 0, 0, mqtt_request_cb, mqtt_ctx);
-    if (err != ERR_OK) {
-        printf("mqtt_publish failed: %d\n", err);
+    uint64_t started_us = time_us_64();
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_STATUS, &json)) return;
+    json_set_format(&json, payload_format);
+    json_object_begin(&json, NULL);
+    json_string(&json, "status", "online");
+    json_uint(&json, "timestamp", current_time);
+    json_uint(&json, "uptime_ms", current_time);
+    json_string(&json, "alarm_state", alarm_state_to_string(alarm_ctx->current_state));
+    json_bool(&json, "wifi_connected", true);
+    json_bool(&json, "mqtt_connected", true);
+    json_string(&json, "version", "1.0.0");
+    json_object_end(&json);
+
+    if (mqtt_queue_commit(MQTT_LANE_STATUS, &json, topics_get(TOPIC_HEARTBEAT), 0, false)) {
+        record_payload(MQTT_PAYLOAD_HEARTBEAT, &json, started_us);
     }
 }
 
@@ -324,146 +498,228 @@ void mqtt_publish_error(MQTT_CLIENT_DATA_T *mqtt_ctx, const char *error_message)
         return;
     }
 
-    // MQTT_FULL_TOPIC_ERROR
-    char topic[128];
-    snprintf(topic, sizeof(topic), MQTT_FULL_TOPIC_ERROR);
-
-    char message[256];
-    snprintf(message, sizeof(message),
-        "{"
-        "\"error\":\"%s\","
-        "\"timestamp\":%lu"
-        "}",
-        error_message,
-        to_ms_since_boot(get_absolute_time())
-    );
-
-    err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, topic, (const u8_t *)message, strlen(message), MQTT_PUBLISH_QOS, MQTT_PUBLISH_RETAIN, mqtt_request_cb, mqtt_ctx);
-    if (err != ERR_OK) {
-        printf("Failed to publish error message: %d\n", err);
-    }
+    json_writer_t json;
+    // Never on the alarm lane, an error burst must not hold back an alarm transition
+    if (!mqtt_queue_begin(MQTT_LANE_EVENT, &json)) return;
+    json_object_begin(&json, NULL);
+    json_string(&json, "error", error_message);
+    json_uint(&json, "timestamp", to_ms_since_boot(get_absolute_time()));
+    json_object_end(&json);
+
+    mqtt_queue_commit(MQTT_LANE_EVENT, &json, topics_get(TOPIC_ERROR), MQTT_PUBLISH_QOS, MQTT_PUBLISH_RETAIN);
 }
 
 void mqtt_publish_system_status(MQTT_CLIENT_DATA_T* mqtt_ctx, system_status_t* status, alarm_context_t *alarm_ctx) {
     if (!mqtt_is_connected(mqtt_ctx)) return;
-    
-    char message[512];
-    snprintf(message, sizeof(message),
-        "{"
-        "\"wifi_status\":\"%s\","
-        "\"mqtt_status\":\"%s\","
-        "\"uptime_ms\":%lu,"
-        "\"sensor_count\":%lu,"
-        "\"timestamp\":%lu,"
-        "\"alarm_state\":\"%s\""
-        "}",
-        status->wifi_status,
-        status->mqtt_status,
-        status->uptime_ms,
-        status->sensor_count,
-        to_ms_since_boot(get_absolute_time()),
-        alarm_state_to_string(alarm_ctx->current_state)
-    );
-
-    char topic[128];
-    snprintf(topic, sizeof(topic), "%s/%s/status", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-
-    err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, topic, 
-                            message, strlen(message), MQTT_PUBLISH_QOS, false, 
-                            mqtt_request_cb, mqtt_ctx);
-    
-    if (err != ERR_OK) {
-        printf("Failed to publish system status: %d\n", err);
+
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_STATUS, &json)) return;
+    json_object_begin(&json, NULL);
+    json_string(&json, "wifi_status", status->wifi_status);
+    json_string(&json, "mqtt_status", status->mqtt_status);
+    json_uint(&json, "uptime_ms", status->uptime_ms);
+    json_uint(&json, "sensor_count", status->sensor_count);
+    json_uint(&json, "timestamp", to_ms_since_boot(get_absolute_time()));
+    json_string(&json, "alarm_state", alarm_state_to_string(alarm_ctx->current_state));
+
+    // Depth and loss per publish lane
+    json_object_begin(&json, "publish_queue");
+    for (int i = 0; i < MQTT_LANE_COUNT; i++) {
+        const mqtt_lane_stats_t *lane = mqtt_queue_get_stats((mqtt_lane_t)i);
+        json_object_begin(&json, mqtt_lane_to_string((mqtt_lane_t)i));
+        json_uint(&json, "depth", lane->depth);
+        json_uint(&json, "high_water", lane->high_water);
+        json_uint(&json, "dropped", lane->dropped);
+        json_uint(&json, "retries", lane->retries);
+        json_uint(&json, "failed", lane->failed);
+        json_object_end(&json);
+    }
+    json_object_end(&json);
+
+    const journal_stats_t *journal = journal_get_stats();
+    json_object_begin(&json, "journal");
+    json_uint(&json, "depth", journal->depth);
+    json_uint(&json, "replayed", journal->replayed);
+    json_uint(&json, "dropped", journal->dropped);
+    json_object_end(&json);
+    json_object_end(&json);
+
+    mqtt_queue_commit(MQTT_LANE_STATUS, &json, topics_get(TOPIC_STATUS), MQTT_PUBLISH_QOS, false);
+}
+
+void mqtt_publish_link_status(MQTT_CLIENT_DATA_T *mqtt_ctx, const network_link_stats_t *link) {
+    if (!mqtt_is_connected(mqtt_ctx)) return;
+
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_STATUS, &json)) return;
+    json_object_begin(&json, NULL);
+    json_int(&json, "rssi_dbm", link->rssi_dbm);
+    json_int(&json, "rssi_min_dbm", link->rssi_min_dbm);
+    json_string(&json, "pm_mode", network_pm_mode_to_string(link->pm_mode));
+    json_uint(&json, "pm_value", link->pm_mode);
+    json_uint(&json, "join_attempts", link->join_attempts);
+    json_uint(&json, "link_losses", link->link_losses);
+    json_uint(&json, "reassociations", link->reassociations);
+    json_uint(&json, "last_recover_ms", link->last_recover_ms);
+    json_uint(&json, "max_recover_ms", link->max_recover_ms);
+    json_string(&json, "pm_profile", network_pm_profile_to_string(network_get_pm_profile()));
+    json_bool(&json, "pm_override", network_pm_override_active());
+
+    // Publish -> PUBACK latency per power-management profile, profiles without samples
+    // are left out. Worst case (~410 B) relies on MQTT_OUTPUT_RINGBUF_SIZE in lwipopts.h.
+    json_object_begin(&json, "publish_latency");
+    for (int i = 0; i < NET_PM_PROFILE_COUNT; i++) {
+        const event_latency_t *stats = network_get_publish_latency((net_pm_profile_t)i);
+        if (stats->count == 0) continue;
+        json_object_begin(&json, network_pm_profile_to_string((net_pm_profile_t)i));
+        json_uint(&json, "n", stats->count);
+        json_uint(&json, "min_us", stats->min_us);
+        json_uint(&json, "avg_us", (uint32_t)(stats->total_us / stats->count));
+        json_uint(&json, "max_us", stats->max_us);
+        json_object_end(&json);
     }
+    json_object_end(&json);
+    json_uint(&json, "timestamp", to_ms_since_boot(get_absolute_time()));
+    json_object_end(&json);
+
+    mqtt_queue_commit(MQTT_LANE_STATUS, &json, topics_get(TOPIC_LINK), MQTT_PUBLISH_QOS, false);
 }
 
 bool mqtt_is_connected(MQTT_CLIENT_DATA_T* mqtt_ctx) {
     return mqtt_ctx && mqtt_ctx->mqtt_client_inst && mqtt_ctx->connect_done;
 }
 
-void mqtt_publish_alarm_state(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ctx) {
-    if (!mqtt_is_connected(mqtt_ctx)) return;
+bool mqtt_publish_alarm_state(MQTT_CLIENT_DATA_T* mqtt_ctx, mqtt_lane_t lane, const journal_entry_t *entry, bool replayed) {
+    topic_id_t topic;
+    if(entry->state == ALARM_STATE_TRIGGERED) {
+        topic = TOPIC_ALARM_TRIGGERED;
+    }
+    else if(entry->state == ALARM_STATE_DISARMED) {
+        topic = TOPIC_ALARM_DISARMED;
+    }
+    else if(entry->state == ALARM_STATE_ARMED) {
+        topic = TOPIC_ALARM_ARMED;
+    }
+    else {
+        return true;  // transient states are not published
+    }
 
-    char message[256];
-    char topic[128];
-
-    if(alarm_ctx->current_state == ALARM_STATE_TRIGGERED) {
-        snprintf(topic, sizeof(topic), "%s/%s/alarm/triggered", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-        snprintf(message, sizeof(message), 
-            "{"
-            "\"triggered_by\":\"%s\","
-            "\"timestamp\":%lu"
-            "}",
-            alarm_ctx->triggered_sensor->computer_name,
-            to_ms_since_boot(get_absolute_time())
-        );
-        err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, topic, 
-            message, strlen(message), MQTT_PUBLISH_QOS, MQTT_PUBLISH_RETAIN, 
-            mqtt_request_cb, mqtt_ctx);
-        if (err != ERR_OK) {
-            printf("Failed to publish alarm triggered: %d\n", err);
-        }
+    uint64_t started_us = time_us_64();
+    json_writer_t json;
+    if (!mqtt_queue_begin(lane, &json)) return false;
+    json_set_format(&json, payload_format);
+    json_object_begin(&json, NULL);
+    if (topic == TOPIC_ALARM_TRIGGERED) {
+        const sensor_config_t *sensor = sensor_get(entry->sensor);
+        json_string(&json, "triggered_by", sensor ? sensor->computer_name : "unknown");
     }
-    else if(alarm_ctx->current_state == ALARM_STATE_DISARMED) {
-        snprintf(topic, sizeof(topic), "%s/%s/alarm/disarmed", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-        snprintf(message, sizeof(message), 
-            "{"
-            "\"timestamp\":%lu"
-            "}",
-            to_ms_since_boot(get_absolute_time())
-        );
-        err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, topic, 
-            message, strlen(message), MQTT_PUBLISH_QOS, MQTT_PUBLISH_RETAIN, 
-            mqtt_request_cb, mqtt_ctx);
-        if (err != ERR_OK) {
-            printf("Failed to publish alarm disarmed: %d\n", err);
-        }
+    json_uint(&json, "seq", entry->seq);
+    json_uint(&json, "timestamp", entry->timestamp_ms);
+    if (replayed) json_bool(&json, "replayed", true);
+    json_object_end(&json);
+
+    // A replayed transition is history, it must not replace a retained current state
+    bool retain = replayed ? false : MQTT_PUBLISH_RETAIN;
+    if (!mqtt_queue_commit(lane, &json, topics_get(topic), MQTT_PUBLISH_QOS, retain)) return false;
+    record_payload(MQTT_PAYLOAD_ALARM, &json, started_us);
+    return true;
+}
+
+// Transient alarm states never reach the broker, so they get no sequence number either
+static bool journal_worthy(const event_record_t *event) {
+    if (event->type != HUB_EVENT_ALARM_CHANGED) return true;
+    return event->level == ALARM_STATE_TRIGGERED || event->level == ALARM_STATE_DISARMED ||
+           event->level == ALARM_STATE_ARMED;
+}
+
+static bool publish_entry(MQTT_CLIENT_DATA_T *mqtt_ctx, const journal_entry_t *entry, bool replayed) {
+    mqtt_lane_t lane = replayed ? MQTT_LANE_REPLAY
+                     : entry->kind == JOURNAL_ALARM_STATE ? MQTT_LANE_ALARM : MQTT_LANE_EVENT;
+    if (!mqtt_queue_space(lane)) return false;
+
+    if (entry->kind == JOURNAL_ALARM_STATE) {
+        return mqtt_publish_alarm_state(mqtt_ctx, lane, entry, replayed);
     }
-    else if(alarm_ctx->current_state == ALARM_STATE_ARMED) {
-        snprintf(topic, sizeof(topic), "%s/%s/alarm/armed", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-        snprintf(message, sizeof(message), 
-            "{"
-            "\"timestamp\":%lu"
-            "}",
-            to_ms_since_boot(get_absolute_time())
-        );
-        err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, topic, 
-            message, strlen(message), MQTT_PUBLISH_QOS, MQTT_PUBLISH_RETAIN, 
-            mqtt_request_cb, mqtt_ctx);
-        if (err != ERR_OK) {
-            printf("Failed to publish alarm armed: %d\n", err);
+    return mqtt_publish_door_state(mqtt_ctx, lane, entry, replayed);
+}
+
+static volatile bool replay_timer_pending = false;
+
+static int64_t replay_timer_callback(alarm_id_t id, void *user_data) {
+    replay_timer_pending = false;
+    events_post(HUB_EVENT_JOURNAL_REPLAY);
+    return 0;
+}
+
+// Replays the journal oldest first, at most one entry per JOURNAL_REPLAY_INTERVAL_MS and
+// only through the replay lane, which goes out after live alarm and door traffic
+static void replay_journal(MQTT_CLIENT_DATA_T *mqtt_ctx, uint32_t current_time) {
+    static uint32_t last_replay_time = 0;
+
+    if (journal_empty()) return;
+
+    uint32_t elapsed = current_time - last_replay_time;
+    if (elapsed < JOURNAL_REPLAY_INTERVAL_MS) {
+        // Nothing else may wake the loop before the next tick
+        if (!replay_timer_pending) {
+            replay_timer_pending = add_alarm_in_ms(JOURNAL_REPLAY_INTERVAL_MS - elapsed, replay_timer_callback, NULL, true) > 0;
         }
+        return;
     }
+
+    journal_entry_t entry;
+    if (journal_peek(&entry) && publish_entry(mqtt_ctx, &entry, true)) {
+        journal_pop();
+        last_replay_time = current_time;
+    }
+    // A full replay lane is retried on HUB_EVENT_MQTT_PUBLISHED
 }
 
 void mqtt_check_and_publish(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ctx) {
-   if (!mqtt_is_connected(mqtt_ctx)) {
-       return;  // Skip if MQTT not connected
-   }
-   
    uint32_t current_time = to_ms_since_boot(get_absolute_time());
    
-   // Check alarm state changes
-   if (mqtt_flags.alarm_state_changed) {
-       // Publish: /sensor_hub/<device>/alarm/status
-       // Body: {"state": "armed|disarmed|triggered", "triggered_by": "button|door|timeout", "timestamp": 123456}
-       mqtt_publish_alarm_state(mqtt_ctx, alarm_ctx);
-       
-       // Clear flag after publishing
-       mqtt_flags.alarm_state_changed = false;
-       mqtt_flags.last_published_alarm_state = alarm_ctx->current_state;
+   // Alarm transitions and door changes are drained even while disconnected. Each one
+   // gets a sequence number; what cannot be queued for publishing right away goes to the
+   // journal and is replayed later, so an outage loses none of the history.
+   // Publish: /sensor_hub/<device>/door/<sensor_id>/open (or /closed)
+   // Body: {"state": "open|closed", "seq": 12, "timestamp": 123456}
+   // Publish: /sensor_hub/<device>/alarm/armed|disarmed|triggered
+   // Body: {"triggered_by": "<sensor>", "seq": 13, "timestamp": 123456}
+   bool connected = mqtt_is_connected(mqtt_ctx);
+   event_record_t event;
+   while (events_pop(EVENT_RING_SENSOR, &event)) {
+       events_mark_record_handled(&event);
+       if (!journal_worthy(&event)) continue;
+
+       journal_entry_t entry = {
+           .seq = journal_next_seq(),
+           .timestamp_ms = (uint32_t)(event.timestamp_us / 1000),
+           .kind = event.type == HUB_EVENT_ALARM_CHANGED ? JOURNAL_ALARM_STATE : JOURNAL_DOOR,
+           .state = event.level,
+           .sensor = (uint8_t)event.data,
+       };
+       if (!connected || !publish_entry(mqtt_ctx, &entry, false)) {
+           journal_append(&entry);
+       }
    }
-   
-   // Check door state changes
-   if (mqtt_flags.door_state_changed) {
-       // Publish: /sensor_hub/<device>/door/<sensor_id>/status
-       // Body: {"state": "open|closed", "timestamp": 123456}
-       // Also publish: /sensor_hub/<device>/door/<sensor_id>/open (or /closed)
-       //mqtt_publish_door_event(mqtt_ctx, mqtt_flags.last_door_sensor, mqtt_flags.last_door_state);
-       mqtt_publish_door_state(mqtt_ctx, mqtt_flags.last_door_state, mqtt_flags.last_door_sensor->computer_name);
-
-       mqtt_flags.door_state_changed = false;
+
+   if (!connected) {
+       return;  // Skip the rest if MQTT not connected
    }
+
+   if (online_announce_pending) {
+       publish_online(mqtt_ctx);
+   }
+
+   if (alarm_announce_pending && alarm_ctx) {
+       publish_current_alarm_state(mqtt_ctx, alarm_ctx);
+   }
+
+   if (format_announce_pending) {
+       publish_payload_format();
+   }
+
+   replay_journal(mqtt_ctx, current_time);
    
    // Check motion sensor changes (if you add them later)
    if (mqtt_flags.motion_state_changed) {
@@ -493,4 +749,7 @@ void mqtt_check_and_publish(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm
        // Body: {"error": "i2c_timeout", "timestamp": 123456}
        mqtt_flags.error_occurred = false;
    }
+
+   // Everything above was only queued, hand it to lwIP in priority order
+   mqtt_queue_service(mqtt_ctx);
 }
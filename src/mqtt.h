@@ -7,9 +7,18 @@
 #include "alarm.h"
 #include "sensor.h"
 #include "common.h"
+#include "events.h"
+#include "network.h"
+#include "journal.h"
+#include "mqtt_queue.h"
+#include "topics.h"
 
 #define HEARTBEAT_INTERVAL_MS 30000
 
+// Inbound commands waiting for the main loop
+#define MQTT_COMMAND_SLOTS 4
+#define MQTT_COMMAND_MAX_LEN 128
+
 // MQTT Configuration
 #define MQTT_BROKER_PORT 8883
 #define MQTT_CLIENT_ID "sensor_hub_pico"
@@ -29,6 +38,18 @@
 #define MQTT_FULL_TOPIC_HEARTBEAT SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/" MQTT_TOPIC_HEARTBEAT
 #define MQTT_FULL_TOPIC_COMMAND SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/" MQTT_TOPIC_COMMAND
 #define MQTT_FULL_TOPIC_ERROR SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/error"
+#define MQTT_FULL_TOPIC_LINK SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/link"
+#define MQTT_FULL_TOPIC_STATUS SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/status"
+#define MQTT_FULL_TOPIC_STATUS_RESPONSE MQTT_FULL_TOPIC_STATUS "/response"
+#define MQTT_FULL_TOPIC_COMMAND_RESPONSE MQTT_FULL_TOPIC_COMMAND "/response"
+#define MQTT_FULL_TOPIC_ALARM SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/alarm"
+#define MQTT_FULL_TOPIC_FORMAT SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/format"
+
+// Encoding of door, alarm and heartbeat payloads, the other topics are always JSON.
+// The current choice is published retained on MQTT_FULL_TOPIC_FORMAT.
+#ifndef MQTT_PAYLOAD_FORMAT_DEFAULT
+#define MQTT_PAYLOAD_FORMAT_DEFAULT PAYLOAD_FORMAT_JSON
+#endif
 
 typedef struct {
     const char *wifi_status;
@@ -37,36 +58,76 @@ typedef struct {
     uint32_t sensor_count;
 } system_status_t;
 
+// Time from mqtt_start_connect() to CONNACK
+typedef struct {
+    uint32_t count;
+    uint32_t last_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;
+    uint32_t heap_peak;             // largest mbedtls heap use during one handshake, bytes
+} mqtt_connect_timing_t;
+
+typedef struct {
+    mqtt_connect_timing_t full;     // complete TLS handshake
+    mqtt_connect_timing_t resumed;  // broker accepted the saved session
+    uint32_t resume_offered;
+    uint32_t session_saves;
+} mqtt_tls_stats_t;
+
+// Payloads whose encoding follows the selected format
+typedef enum {
+    MQTT_PAYLOAD_DOOR,
+    MQTT_PAYLOAD_ALARM,
+    MQTT_PAYLOAD_HEARTBEAT,
+    MQTT_PAYLOAD_KIND_COUNT
+} mqtt_payload_kind_t;
+
+// Size and encode time per payload kind and format
+typedef struct {
+    uint32_t count;
+    uint32_t last_bytes;
+    uint32_t total_bytes;
+    uint32_t total_encode_us;
+} mqtt_payload_stats_t;
+
 typedef struct {
-    bool alarm_state_changed;
-    bool door_state_changed;
     bool motion_state_changed;
     bool button_pressed;
     uint32_t last_heartbeat_time;
     bool error_occurred;
-    uint32_t last_published_alarm_state;
-    sensor_config_t* last_door_sensor;
-    bool last_door_state;
 } mqtt_flags_t;
 
 extern mqtt_flags_t mqtt_flags;
 
 MQTT_CLIENT_DATA_T* mqtt_init();
-int mqtt_connect(MQTT_CLIENT_DATA_T* mqtt_ctx, char* broker_ip);
+// Starts the TCP/TLS + MQTT CONNECT to mqtt_server_address, the outcome arrives as
+// HUB_EVENT_MQTT_CONNECTION
+bool mqtt_start_connect(MQTT_CLIENT_DATA_T* mqtt_ctx);
+void mqtt_abort_connect(MQTT_CLIENT_DATA_T* mqtt_ctx);
+const mqtt_tls_stats_t* mqtt_get_tls_stats(void);
+void mqtt_print_tls_stats(void);
 void mqtt_request_cb(void *arg, err_t err);
-static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status);
-static void mqtt_incoming_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags);
-static void mqtt_incoming_publish_cb(void *arg, const char *topic, u32_t tot_len);
-void mqtt_publish_door_state(MQTT_CLIENT_DATA_T *mqtt_ctx, bool door_state, const char *sensor_id);
-void dns_found(const char *hostname, const ip_addr_t *ipaddr, void *arg);
+// Alarm transitions and door changes carry their journal sequence number and the time
+// they happened, replayed ones are marked. False if the lane had no room.
+bool mqtt_publish_door_state(MQTT_CLIENT_DATA_T *mqtt_ctx, mqtt_lane_t lane, const journal_entry_t *entry, bool replayed);
+bool mqtt_publish_alarm_state(MQTT_CLIENT_DATA_T *mqtt_ctx, mqtt_lane_t lane, const journal_entry_t *entry, bool replayed);
 bool mqtt_is_connected(MQTT_CLIENT_DATA_T* mqtt_ctx);
 void mqtt_publish_system_status(MQTT_CLIENT_DATA_T* mqtt_ctx, system_status_t* status, alarm_context_t *alarm_ctx);
 void mqtt_publish_heartbeat(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm_ctx);
 void mqtt_publish_error(MQTT_CLIENT_DATA_T *mqtt_ctx, const char *error_message);
+void mqtt_publish_link_status(MQTT_CLIENT_DATA_T *mqtt_ctx, const network_link_stats_t *link);
 void mqtt_check_and_publish(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ctx);
-void mqtt_handle_reconnection(MQTT_CLIENT_DATA_T *mqtt_ctx);
 void mqtt_set_alarm_context(alarm_context_t* alarm_ctx);
 
+void mqtt_set_payload_format(payload_format_t format);
+payload_format_t mqtt_get_payload_format(void);
+const char* mqtt_payload_format_to_string(payload_format_t format);
+// PAYLOAD_FORMAT_COUNT if the name is unknown
+payload_format_t mqtt_payload_format_from_string(const char *name);
+const mqtt_payload_stats_t* mqtt_get_payload_stats(mqtt_payload_kind_t kind, payload_format_t format);
+void mqtt_print_payload_stats(void);
+void mqtt_process_command(MQTT_CLIENT_DATA_T* mqtt_ctx, const event_record_t *event);
+
 // Command handling functions
 void mqtt_handle_command(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ctx, const char* command_json);
 void mqtt_publish_command_response(MQTT_CLIENT_DATA_T* mqtt_ctx, const char* status, const char* message, const char* command);
@@ -9,6 +9,7 @@
 #include "lwip/dns.h"
 #include "main.h"
 #include "alarm.h"
+#include "mqtt_queue.h"
 
 // Simple JSON parsing functions (lightweight alternative to cJSON)
 static const char* find_json_value(const char* json, const char* key) {
@@ -83,7 +84,7 @@ void mqtt_handle_command(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ct
     // Handle commands
     if (strcmp(command, "arm") == 0) {
         if (alarm_ctx->current_state == ALARM_STATE_DISARMED) {
-            update_alarm_state(alarm_ctx, EVENT_EXIT_DELAY);
+            alarm_post_event(EVENT_EXIT_DELAY);
             mqtt_publish_command_response(mqtt_ctx, "success", "Arming initiated with exit delay", command);
             printf("Remote ARM command executed - starting exit delay\n");
         } else if (alarm_ctx->current_state == ALARM_STATE_ARMED) {
@@ -99,7 +100,7 @@ void mqtt_handle_command(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ct
     }
     else if (strcmp(command, "disarm") == 0) {
         if (alarm_ctx->current_state != ALARM_STATE_DISARMED) {
-            update_alarm_state(alarm_ctx, EVENT_DISARM);
+            alarm_post_event(EVENT_DISARM);
             mqtt_publish_command_response(mqtt_ctx, "success", "System disarmed", command);
             printf("Remote DISARM command executed\n");
         } else {
@@ -113,7 +114,7 @@ void mqtt_handle_command(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ct
     }
     else if (strcmp(command, "reset") == 0) {
         if (alarm_ctx->current_state != ALARM_STATE_DISARMED) {
-            update_alarm_state(alarm_ctx, EVENT_RESET);
+            alarm_post_event(EVENT_RESET);
             mqtt_publish_command_response(mqtt_ctx, "success", "System reset to armed state", command);
             printf("Remote RESET command executed\n");
         } else {
@@ -121,6 +122,49 @@ void mqtt_handle_command(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t* alarm_ct
             printf("RESET command ignored - system already disarmed\n");
         }
     }
+    else if (strcmp(command, "scan") == 0) {
+        // Diagnostic only, blocks the main loop for the duration of the scan
+        uint8_t found[16];
+        int found_count = bus_scan(found, sizeof(found));
+
+        char message[128];
+        int len = snprintf(message, sizeof(message), "%d I2C device(s):", found_count);
+        for (int i = 0; i < found_count && i < (int)sizeof(found) && len < (int)sizeof(message) - 6; i++) {
+            len += snprintf(message + len, sizeof(message) - len, " 0x%02x", found[i]);
+        }
+        mqtt_publish_command_response(mqtt_ctx, "success", message, command);
+        printf("Bus scan command processed\n");
+    }
+    else if (strcmp(command, "power") == 0) {
+        // {"command":"power","profile":"auto|performance|balanced|save"}
+        char profile_name[16] = {0};
+        extract_json_string(command_json, "profile", profile_name, sizeof(profile_name));
+        net_pm_profile_t profile = network_pm_profile_from_string(profile_name);
+        if (profile > NET_PM_AUTO) {
+            mqtt_publish_command_response(mqtt_ctx, "error", "Unknown power profile", command);
+        } else {
+            network_set_pm_override(profile);
+            char message[64];
+            snprintf(message, sizeof(message), "Power profile %s%s",
+                     network_pm_profile_to_string(network_get_pm_profile()),
+                     profile == NET_PM_AUTO ? " (follows alarm state)" : "");
+            mqtt_publish_command_response(mqtt_ctx, "success", message, command);
+        }
+        printf("Power command processed: %s\n", profile_name);
+    }
+    else if (strcmp(command, "format") == 0) {
+        // {"command":"format","format":"json|cbor"}, applies to door, alarm and heartbeat payloads
+        char format_name[8] = {0};
+        extract_json_string(command_json, "format", format_name, sizeof(format_name));
+        payload_format_t format = mqtt_payload_format_from_string(format_name);
+        if (format >= PAYLOAD_FORMAT_COUNT) {
+            mqtt_publish_command_response(mqtt_ctx, "error", "Unknown payload format", command);
+        } else {
+            mqtt_set_payload_format(format);
+            mqtt_publish_command_response(mqtt_ctx, "success", mqtt_payload_format_to_string(format), command);
+        }
+        printf("Format command processed: %s\n", format_name);
+    }
     else {
         mqtt_publish_command_response(mqtt_ctx, "error", "Unknown command", command);
         printf("Unknown command received: %s\n", command);
@@ -133,33 +177,17 @@ void mqtt_publish_command_response(MQTT_CLIENT_DATA_T* mqtt_ctx, const char* sta
         return;
     }
     
-    char response_topic[128];
-    char response_message[256];
-    
-    snprintf(response_topic, sizeof(response_topic), "%s/%s/cmd/response", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-    
-    snprintf(response_message, sizeof(response_message),
-        "{"
-        "\"status\":\"%s\","
-        "\"message\":\"%s\","
-        "\"command\":\"%s\","
-        "\"timestamp\":%lu"
-        "}",
-        status,
-        message,
-        command ? command : "",
-        to_ms_since_boot(get_absolute_time())
-    );
-    
-    err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, response_topic,
-                            response_message, strlen(response_message),
-                            MQTT_PUBLISH_QOS, false,
-                            mqtt_request_cb, mqtt_ctx);
-    
-    if (err != ERR_OK) {
-        printf("Failed to publish command response: %d\n", err);
-    } else {
-        printf("Published command response: %s\n", response_message);
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_EVENT, &json)) return;
+    json_object_begin(&json, NULL);
+    json_string(&json, "status", status);
+    json_string(&json, "message", message);
+    json_string(&json, "command", command);
+    json_uint(&json, "timestamp", to_ms_since_boot(get_absolute_time()));
+    json_object_end(&json);
+    
+    if (mqtt_queue_commit(MQTT_LANE_EVENT, &json, topics_get(TOPIC_COMMAND_RESPONSE), MQTT_PUBLISH_QOS, false)) {
+        printf("Queued command response: %s\n", json.buf);
     }
 }
 
@@ -169,38 +197,22 @@ void mqtt_publish_status_response(MQTT_CLIENT_DATA_T* mqtt_ctx, alarm_context_t*
         return;
     }
     
-    char status_topic[128];
-    char status_message[512];
     uint32_t current_time = to_ms_since_boot(get_absolute_time());
     
-    snprintf(status_topic, sizeof(status_topic), "%s/%s/status/response", SENSOR_ROOT_TOPIC, DEVICE_NAME);
-    
-    snprintf(status_message, sizeof(status_message),
-        "{"
-        "\"alarm_state\":\"%s\","
-        "\"uptime_ms\":%lu,"
-        "\"wifi_connected\":true,"
-        "\"mqtt_connected\":true,"
-        "\"exit_delay_active\":%s,"
-        "\"entry_delay_active\":%s,"
-        "\"timestamp\":%lu,"
-        "\"version\":\"1.0.0\""
-        "}",
-        alarm_state_to_string(alarm_ctx->current_state),
-        current_time,
-        alarm_ctx->exit_delay_active ? "true" : "false",
-        alarm_ctx->enter_delay_active ? "true" : "false",
-        current_time
-    );
-    
-    err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, status_topic,
-                            status_message, strlen(status_message),
-                            MQTT_PUBLISH_QOS, false,
-                            mqtt_request_cb, mqtt_ctx);
-    
-    if (err != ERR_OK) {
-        printf("Failed to publish status response: %d\n", err);
-    } else {
-        printf("Published status response: %s\n", status_message);
+    json_writer_t json;
+    if (!mqtt_queue_begin(MQTT_LANE_EVENT, &json)) return;
+    json_object_begin(&json, NULL);
+    json_string(&json, "alarm_state", alarm_state_to_string(alarm_ctx->current_state));
+    json_uint(&json, "uptime_ms", current_time);
+    json_bool(&json, "wifi_connected", true);
+    json_bool(&json, "mqtt_connected", true);
+    json_bool(&json, "exit_delay_active", alarm_ctx->exit_delay_active);
+    json_bool(&json, "entry_delay_active", alarm_ctx->enter_delay_active);
+    json_uint(&json, "timestamp", current_time);
+    json_string(&json, "version", "1.0.0");
+    json_object_end(&json);
+    
+    if (mqtt_queue_commit(MQTT_LANE_EVENT, &json, topics_get(TOPIC_STATUS_RESPONSE), MQTT_PUBLISH_QOS, false)) {
+        printf("Queued status response: %s\n", json.buf);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,269 @@
+#include "mqtt_queue.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "lwip/apps/mqtt.h"
+#include "mqtt.h"
+#include "network.h"
+#include "events.h"
+
+typedef struct {
+    const char *topic;      // interned, see topics.h
+    char payload[MQTT_QUEUE_PAYLOAD_LEN];
+    uint16_t len;
+    uint8_t qos;
+    bool retain;
+} mqtt_queue_slot_t;
+
+typedef struct {
+    uint8_t capacity;
+    bool drop_oldest;       // newer status supersedes older, events must not be reordered
+} mqtt_lane_config_t;
+
+#define MQTT_ALARM_SLOTS 8
+#define MQTT_EVENT_SLOTS 12
+#define MQTT_REPLAY_SLOTS 2
+#define MQTT_STATUS_SLOTS 4
+#define MQTT_QUEUE_SLOTS (MQTT_ALARM_SLOTS + MQTT_EVENT_SLOTS + MQTT_REPLAY_SLOTS + MQTT_STATUS_SLOTS)
+
+// mqtt_queue_init() hands out slot_storage with a uint8_t offset
+_Static_assert(MQTT_LANE_COUNT == 4, "every lane needs its MQTT_*_SLOTS in MQTT_QUEUE_SLOTS");
+_Static_assert(MQTT_QUEUE_SLOTS <= UINT8_MAX, "slot offsets are 8 bit");
+
+static const mqtt_lane_config_t lane_config[MQTT_LANE_COUNT] = {
+    [MQTT_LANE_ALARM] = { .capacity = MQTT_ALARM_SLOTS, .drop_oldest = false },
+    [MQTT_LANE_EVENT] = { .capacity = MQTT_EVENT_SLOTS, .drop_oldest = false },
+    [MQTT_LANE_REPLAY] = { .capacity = MQTT_REPLAY_SLOTS, .drop_oldest = false },
+    [MQTT_LANE_STATUS] = { .capacity = MQTT_STATUS_SLOTS, .drop_oldest = true },
+};
+
+// lwIP only accepts a PUBLISH that fits its output ring in one piece, anything
+// larger fails with ERR_MEM forever
+_Static_assert(MQTT_PUBLISH_OVERHEAD + MQTT_QUEUE_TOPIC_MAX + MQTT_QUEUE_PAYLOAD_LEN <= MQTT_OUTPUT_RINGBUF_SIZE,
+               "MQTT_OUTPUT_RINGBUF_SIZE (lwipopts.h) is too small for the largest queued message");
+
+typedef struct {
+    mqtt_queue_slot_t *slots;
+    uint8_t head;
+    uint8_t count;
+} mqtt_lane_queue_t;
+
+static mqtt_queue_slot_t slot_storage[MQTT_QUEUE_SLOTS];
+static mqtt_lane_queue_t lanes[MQTT_LANE_COUNT];
+static mqtt_lane_stats_t lane_stats[MQTT_LANE_COUNT];
+
+// One per publish handed to lwIP, released by its completion callback (lwIP context).
+// mqtt_close() frees pending requests without calling it, so every connection change
+// resets the slots and bumps the generation; the callback argument carries slot index
+// and generation, a late callback from an older connection is ignored.
+typedef struct {
+    volatile bool busy;
+    uint8_t lane;
+    uint8_t profile;
+    uint16_t generation;
+    uint64_t started_us;
+} mqtt_in_flight_t;
+
+static mqtt_in_flight_t in_flight[MQTT_QUEUE_IN_FLIGHT];
+static uint16_t in_flight_generation = 0;
+
+#define IN_FLIGHT_ARG(index, generation) ((void *)(uintptr_t)(((uint32_t)(generation) << 8) | (index)))
+
+static void publish_done(void *arg, err_t err) {
+    uint32_t index = (uint32_t)(uintptr_t)arg & 0xFF;
+    uint16_t generation = (uint16_t)((uint32_t)(uintptr_t)arg >> 8);
+    if (index >= MQTT_QUEUE_IN_FLIGHT) return;
+
+    mqtt_in_flight_t *req = &in_flight[index];
+    if (!req->busy || req->generation != generation) return;
+
+    if (err == ERR_OK) {
+        // Alarm and door publishes are timed against the radio power profile
+        if (req->lane != MQTT_LANE_STATUS) {
+            uint64_t elapsed = time_us_64() - req->started_us;
+            network_record_publish_latency((net_pm_profile_t)req->profile,
+                                           elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+        }
+    } else {
+        printf("MQTT publish failed: %d\n", err);
+        lane_stats[req->lane].failed++;
+    }
+    req->busy = false;
+
+    // A request slot is free again, let the main loop retry what ERR_MEM held back
+    events_post(HUB_EVENT_MQTT_PUBLISHED);
+}
+
+static int claim_in_flight(void) {
+    for (int i = 0; i < MQTT_QUEUE_IN_FLIGHT; i++) {
+        if (!in_flight[i].busy) return i;
+    }
+    return -1;
+}
+
+void mqtt_queue_reset_in_flight(void) {
+    uint8_t lost = 0;
+
+    // Keeps publish_done() out while the slots change hands
+    cyw43_arch_lwip_begin();
+    for (int i = 0; i < MQTT_QUEUE_IN_FLIGHT; i++) {
+        if (in_flight[i].busy) {
+            lane_stats[in_flight[i].lane].failed++;
+            in_flight[i].busy = false;
+            lost++;
+        }
+    }
+    in_flight_generation++;
+    cyw43_arch_lwip_end();
+
+    if (lost) {
+        printf("MQTT connection changed, %u unacknowledged publish(es) abandoned\n", lost);
+    }
+}
+
+static void lane_pop(mqtt_lane_t lane) {
+    mqtt_lane_queue_t *q = &lanes[lane];
+    q->head = (q->head + 1) % lane_config[lane].capacity;
+    q->count--;
+    lane_stats[lane].depth = q->count;
+}
+
+void mqtt_queue_init(void) {
+    uint8_t offset = 0;
+    for (int i = 0; i < MQTT_LANE_COUNT; i++) {
+        lanes[i].slots = &slot_storage[offset];
+        lanes[i].head = 0;
+        lanes[i].count = 0;
+        offset += lane_config[i].capacity;
+    }
+    memset(lane_stats, 0, sizeof(lane_stats));
+}
+
+bool mqtt_queue_begin(mqtt_lane_t lane, json_writer_t *json) {
+    if (lane >= MQTT_LANE_COUNT) return false;
+
+    mqtt_lane_queue_t *q = &lanes[lane];
+    const mqtt_lane_config_t *config = &lane_config[lane];
+    if (q->count >= config->capacity) {
+        lane_stats[lane].dropped++;
+        if (!config->drop_oldest) {
+            printf("MQTT %s lane full, message dropped\n", mqtt_lane_to_string(lane));
+            return false;
+        }
+        lane_pop(lane);
+    }
+
+    mqtt_queue_slot_t *slot = &q->slots[(q->head + q->count) % config->capacity];
+    json_init(json, slot->payload, sizeof(slot->payload));
+    return true;
+}
+
+bool mqtt_queue_commit(mqtt_lane_t lane, json_writer_t *json, const char *topic, uint8_t qos, bool retain) {
+    if (lane >= MQTT_LANE_COUNT || !topic) return false;
+
+    uint16_t len = json_finish(json);
+    if (!len) {
+        printf("MQTT message for %s too long, dropped\n", topic);
+        lane_stats[lane].dropped++;
+        return false;
+    }
+    if (MQTT_PUBLISH_OVERHEAD + strlen(topic) + len > MQTT_OUTPUT_RINGBUF_SIZE) {
+        // Would never fit the lwIP output ring, retrying it would only block the lane
+        printf("MQTT message for %s exceeds the %d byte output ring, dropped\n", topic, MQTT_OUTPUT_RINGBUF_SIZE);
+        lane_stats[lane].failed++;
+        return false;
+    }
+
+    mqtt_lane_queue_t *q = &lanes[lane];
+    mqtt_queue_slot_t *slot = &q->slots[(q->head + q->count) % lane_config[lane].capacity];
+    slot->topic = topic;
+    slot->len = len;
+    slot->qos = qos;
+    slot->retain = retain;
+    q->count++;
+
+    mqtt_lane_stats_t *stats = &lane_stats[lane];
+    stats->enqueued++;
+    stats->depth = q->count;
+    if (q->count > stats->high_water) stats->high_water = q->count;
+    return true;
+}
+
+uint8_t mqtt_queue_space(mqtt_lane_t lane) {
+    if (lane >= MQTT_LANE_COUNT) return 0;
+    return lane_config[lane].capacity - lanes[lane].count;
+}
+
+void mqtt_queue_service(MQTT_CLIENT_DATA_T *mqtt_ctx) {
+    if (!mqtt_is_connected(mqtt_ctx)) return;
+
+    // Strict priority: a lower lane only goes out once every higher lane is empty
+    for (int lane = 0; lane < MQTT_LANE_COUNT; lane++) {
+        mqtt_lane_queue_t *q = &lanes[lane];
+        while (q->count) {
+            int index = claim_in_flight();
+            if (index < 0) return;
+
+            mqtt_in_flight_t *req = &in_flight[index];
+            mqtt_queue_slot_t *slot = &q->slots[q->head];
+            req->lane = (uint8_t)lane;
+            req->profile = (uint8_t)network_get_pm_profile();
+            req->started_us = time_us_64();
+
+            cyw43_arch_lwip_begin();
+            req->generation = in_flight_generation;
+            req->busy = true;
+            err_t err = mqtt_publish(mqtt_ctx->mqtt_client_inst, slot->topic, slot->payload, slot->len,
+                                     slot->qos, slot->retain, publish_done,
+                                     IN_FLIGHT_ARG(index, req->generation));
+            cyw43_arch_lwip_end();
+
+            if (err == ERR_OK) {
+                lane_stats[lane].published++;
+                lane_pop((mqtt_lane_t)lane);
+                continue;
+            }
+
+            req->busy = false;
+            if (err == ERR_MEM) {
+                // Request window or send buffer full, retried when a publish completes
+                lane_stats[lane].retries++;
+                return;
+            }
+            if (err == ERR_CONN) {
+                // Connection went away, everything stays queued for the reconnect
+                return;
+            }
+            printf("mqtt_publish of %s failed: %d, dropped\n", slot->topic, err);
+            lane_stats[lane].failed++;
+            lane_pop((mqtt_lane_t)lane);
+        }
+    }
+}
+
+const mqtt_lane_stats_t* mqtt_queue_get_stats(mqtt_lane_t lane) {
+    if (lane >= MQTT_LANE_COUNT) return NULL;
+    return &lane_stats[lane];
+}
+
+void mqtt_queue_print_stats(void) {
+    printf("MQTT publish queue:\n");
+    for (int i = 0; i < MQTT_LANE_COUNT; i++) {
+        const mqtt_lane_stats_t *stats = &lane_stats[i];
+        printf("  %-6s depth %u/%u (high %u), %lu queued, %lu sent, %lu dropped, %lu ERR_MEM retries, %lu failed\n",
+               mqtt_lane_to_string((mqtt_lane_t)i),
+               stats->depth, lane_config[i].capacity, stats->high_water,
+               stats->enqueued, stats->published, stats->dropped, stats->retries, stats->failed);
+    }
+}
+
+const char* mqtt_lane_to_string(mqtt_lane_t lane) {
+    switch (lane) {
+        case MQTT_LANE_ALARM: return "alarm";
+        case MQTT_LANE_EVENT: return "event";
+        case MQTT_LANE_REPLAY: return "replay";
+        case MQTT_LANE_STATUS: return "status";
+        default: return "unknown";
+    }
+}
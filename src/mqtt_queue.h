@@ -0,0 +1,61 @@
+#ifndef MQTT_QUEUE_H
+#define MQTT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "json.h"
+
+// Outbound MQTT publish queue. Payloads are written in place into per-priority lanes
+// and handed to lwIP from the main loop, highest lane first. When lwIP runs out of
+// request slots or send buffer (ERR_MEM) the message stays queued and is retried
+// once an in-flight publish completes.
+
+#define MQTT_QUEUE_PAYLOAD_LEN 640
+#define MQTT_QUEUE_TOPIC_MAX 96     // longest interned topic, checked again at commit
+#define MQTT_PUBLISH_OVERHEAD 9     // fixed header (1 + up to 4 length bytes), topic length, packet id
+#define MQTT_QUEUE_IN_FLIGHT 8      // >= MQTT_REQ_MAX_IN_FLIGHT, lwIP limits the window first
+
+typedef enum {
+    MQTT_LANE_ALARM,        // alarm transitions
+    MQTT_LANE_EVENT,        // door events, command responses, errors
+    MQTT_LANE_REPLAY,       // journaled events replayed after an outage
+    MQTT_LANE_STATUS,       // heartbeat, status, link telemetry
+    MQTT_LANE_COUNT
+} mqtt_lane_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t published;     // accepted by lwIP
+    uint32_t dropped;       // lane full
+    uint32_t retries;       // ERR_MEM, left queued for the next attempt
+    uint32_t failed;        // rejected by lwIP or not acknowledged
+    uint8_t depth;
+    uint8_t high_water;
+} mqtt_lane_stats_t;
+
+void mqtt_queue_init(void);
+
+// Points the JSON writer at the lane's next free slot. A full alarm, event or replay
+// lane refuses the new message, a full status lane gives up its oldest one.
+// Main loop only, nothing may be queued on the lane before the matching commit.
+bool mqtt_queue_begin(mqtt_lane_t lane, json_writer_t *json);
+// Queues the payload written since mqtt_queue_begin(), dropped if it did not fit.
+// The topic must be an interned string from topics.h.
+bool mqtt_queue_commit(mqtt_lane_t lane, json_writer_t *json, const char *topic, uint8_t qos, bool retain);
+
+// Free slots in a lane, producers with their own backlog stop pulling when it is 0
+uint8_t mqtt_queue_space(mqtt_lane_t lane);
+
+// Hands queued messages to lwIP while connected, call from the main loop
+void mqtt_queue_service(MQTT_CLIENT_DATA_T *mqtt_ctx);
+
+// Call for every HUB_EVENT_MQTT_CONNECTION. lwIP drops its pending requests on
+// disconnect without completing them, so their in-flight slots are reclaimed here.
+void mqtt_queue_reset_in_flight(void);
+
+const mqtt_lane_stats_t* mqtt_queue_get_stats(mqtt_lane_t lane);
+void mqtt_queue_print_stats(void);
+const char* mqtt_lane_to_string(mqtt_lane_t lane);
+
+#endif // MQTT_QUEUE_H
@@ -0,0 +1,403 @@
+#include "network.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "main.h"
+#include "mqtt.h"
+#include "resolver.h"
+
+static MQTT_CLIENT_DATA_T *g_mqtt_ctx = NULL;
+static net_state_t state = NET_STATE_OFF;
+static net_state_t retry_state;         // step to run again once the backoff ends
+static uint32_t state_entered_ms;
+static uint32_t backoff_ms = NETWORK_BACKOFF_MIN_MS;
+
+static network_link_stats_t link_stats;
+static bool link_was_up;                // false until the first join, losses only count after it
+static bool recovering;                 // a loss is being recovered from, lost_at_ms is valid
+static uint32_t lost_at_ms;
+static uint32_t last_sample_ms;
+
+// cyw43_wifi_pm() value per profile
+static const uint32_t pm_profile_value[NET_PM_PROFILE_COUNT] = {
+    [NET_PM_PERFORMANCE] = CYW43_NONE_PM,
+    [NET_PM_BALANCED] = CYW43_DEFAULT_PM,
+    [NET_PM_SAVE] = CYW43_AGGRESSIVE_PM,
+};
+
+// Full performance while an intrusion is being handled, power save when nobody cares
+static const net_pm_profile_t alarm_state_pm_profile[ALARM_STATE_COUNT] = {
+    [ALARM_STATE_ARMED] = NET_PM_BALANCED,
+    [ALARM_STATE_ARMING] = NET_PM_BALANCED,
+    [ALARM_STATE_DISARMED] = NET_PM_SAVE,
+    [ALARM_STATE_TRIGGERED] = NET_PM_PERFORMANCE,
+    [ALARM_STATE_TRIGGERING] = NET_PM_PERFORMANCE,
+};
+
+static net_pm_profile_t pm_profile = NET_PM_BALANCED;      // wanted profile
+static net_pm_profile_t pm_auto_profile = NET_PM_BALANCED; // from the alarm state
+static bool pm_override = false;
+static bool pm_applied = false;     // pm_profile is what the chip runs with
+static event_latency_t publish_latency[NET_PM_PROFILE_COUNT];
+
+static inline uint32_t now_ms(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+static void set_state(net_state_t next) {
+    if (next != state) {
+        printf("Network: %s -> %s\n", network_state_to_string(state), network_state_to_string(next));
+    }
+    state = next;
+    state_entered_ms = now_ms();
+}
+
+static void backoff(net_state_t retry) {
+    retry_state = retry;
+    set_state(NET_STATE_BACKOFF);
+    printf("Network: retrying %s in %lu ms\n", network_state_to_string(retry), backoff_ms);
+}
+
+static void start_join(void) {
+    link_stats.join_attempts++;
+    int err = cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK);
+    if (err) {
+        printf("Wi-Fi join could not be started: %d\n", err);
+        backoff(NET_STATE_WIFI_JOIN);
+        return;
+    }
+    set_state(NET_STATE_WIFI_JOIN);
+}
+
+static void start_connect(void) {
+    if (!mqtt_start_connect(g_mqtt_ctx)) {
+        backoff(NET_STATE_MQTT_CONNECT);
+        return;
+    }
+    set_state(NET_STATE_MQTT_CONNECT);
+}
+
+// Connects right away whenever the resolver has any address, only the very first
+// connect without a fallback address has to wait for DNS
+static bool connect_resolved(void) {
+    resolver_source_t source = resolver_get(&g_mqtt_ctx->mqtt_server_address);
+    if (source == RESOLVER_SOURCE_NONE) return false;
+    printf("Using %s address for %s\n", resolver_source_to_string(source), MQTT_SERVER);
+    start_connect();
+    return true;
+}
+
+static void start_dns(void) {
+    bool pending = resolver_refresh(false);
+    if (connect_resolved()) return;
+    if (pending) {
+        set_state(NET_STATE_DNS);
+    } else {
+        backoff(NET_STATE_DNS);
+    }
+}
+
+// Reads RSSI and the power-management mode back from the chip
+static void sample_link(void) {
+    int32_t rssi;
+    uint32_t pm;
+    cyw43_arch_lwip_begin();
+    int rssi_err = cyw43_wifi_get_rssi(&cyw43_state, &rssi);
+    int pm_err = cyw43_wifi_get_pm(&cyw43_state, &pm);
+    cyw43_arch_lwip_end();
+
+    if (rssi_err == 0) {
+        link_stats.rssi_dbm = rssi;
+        if (link_stats.rssi_min_dbm == 0 || rssi < link_stats.rssi_min_dbm) link_stats.rssi_min_dbm = rssi;
+    }
+    if (pm_err == 0) {
+        link_stats.pm_mode = pm;
+    }
+    last_sample_ms = now_ms();
+}
+
+// Only once cyw43 is initialised, re-applied after every join
+static void apply_pm_profile(void) {
+    if (state == NET_STATE_OFF) return;
+
+    cyw43_arch_lwip_begin();
+    int err = cyw43_wifi_pm(&cyw43_state, pm_profile_value[pm_profile]);
+    cyw43_arch_lwip_end();
+
+    pm_applied = err == 0;
+    if (pm_applied) {
+        printf("Radio power management: %s\n", network_pm_profile_to_string(pm_profile));
+    } else {
+        printf("Setting power management profile %s failed: %d\n", network_pm_profile_to_string(pm_profile), err);
+    }
+}
+
+static void select_pm_profile(net_pm_profile_t profile) {
+    if (profile == pm_profile && pm_applied) return;
+    pm_profile = profile;
+    pm_applied = false;
+    apply_pm_profile();
+}
+
+// The driver does not rejoin on its own. The first join after a loss starts right
+// away, only repeated failures go through the backoff.
+static void link_lost(void) {
+    printf("Wi-Fi link lost\n");
+    link_stats.link_losses++;
+    if (!recovering) {
+        recovering = true;
+        lost_at_ms = now_ms();
+    }
+    mqtt_abort_connect(g_mqtt_ctx);
+    start_join();
+}
+
+static void run_step(net_state_t step) {
+    switch (step) {
+        case NET_STATE_WIFI_JOIN: start_join(); break;
+        case NET_STATE_DNS: start_dns(); break;
+        case NET_STATE_MQTT_CONNECT: start_connect(); break;
+        default: break;
+    }
+}
+
+void network_init(MQTT_CLIENT_DATA_T *mqtt_ctx) {
+    g_mqtt_ctx = mqtt_ctx;
+    resolver_init(MQTT_SERVER);
+    state = NET_STATE_OFF;
+    backoff_ms = NETWORK_BACKOFF_MIN_MS;
+}
+
+void network_start(void) {
+    cyw43_arch_enable_sta_mode();
+    start_join();
+    apply_pm_profile();
+}
+
+void network_apply_alarm_state(alarm_state_t alarm_state) {
+    if (alarm_state >= ALARM_STATE_COUNT) return;
+    pm_auto_profile = alarm_state_pm_profile[alarm_state];
+    if (!pm_override) {
+        select_pm_profile(pm_auto_profile);
+    }
+}
+
+void network_set_pm_override(net_pm_profile_t profile) {
+    if (profile >= NET_PM_PROFILE_COUNT) {
+        pm_override = false;
+        select_pm_profile(pm_auto_profile);
+    } else {
+        pm_override = true;
+        select_pm_profile(profile);
+    }
+}
+
+net_pm_profile_t network_get_pm_profile(void) {
+    return pm_profile;
+}
+
+bool network_pm_override_active(void) {
+    return pm_override;
+}
+
+const char* network_pm_profile_to_string(net_pm_profile_t profile) {
+    switch (profile) {
+        case NET_PM_PERFORMANCE: return "performance";
+        case NET_PM_BALANCED: return "balanced";
+        case NET_PM_SAVE: return "save";
+        default: return "auto";
+    }
+}
+
+net_pm_profile_t network_pm_profile_from_string(const char *name) {
+    if (strcmp(name, "auto") == 0) return NET_PM_AUTO;
+    for (int i = 0; i < NET_PM_PROFILE_COUNT; i++) {
+        if (strcmp(name, network_pm_profile_to_string((net_pm_profile_t)i)) == 0) {
+            return (net_pm_profile_t)i;
+        }
+    }
+    return (net_pm_profile_t)(NET_PM_PROFILE_COUNT + 1);
+}
+
+void network_record_publish_latency(net_pm_profile_t profile, uint32_t latency_us) {
+    if (profile >= NET_PM_PROFILE_COUNT) return;
+    event_latency_t *stats = &publish_latency[profile];
+    if (stats->count == 0 || latency_us < stats->min_us) stats->min_us = latency_us;
+    if (latency_us > stats->max_us) stats->max_us = latency_us;
+    stats->total_us += latency_us;
+    stats->count++;
+}
+
+const event_latency_t* network_get_publish_latency(net_pm_profile_t profile) {
+    if (profile >= NET_PM_PROFILE_COUNT) return NULL;
+    return &publish_latency[profile];
+}
+
+void network_handle_event(const event_record_t *event) {
+    switch ((hub_event_t)event->type) {
+        case HUB_EVENT_DNS_RESULT:
+            // Background refreshes land here too, they only update the cache
+            resolver_handle_result(event);
+            if (state == NET_STATE_DNS && !connect_resolved()) {
+                backoff(NET_STATE_DNS);
+            }
+            break;
+
+        case HUB_EVENT_MQTT_CONNECTION:
+            if (event->level) {
+                set_state(NET_STATE_ONLINE);
+                backoff_ms = NETWORK_BACKOFF_MIN_MS;
+                if (recovering) {
+                    recovering = false;
+                    link_stats.last_recover_ms = now_ms() - lost_at_ms;
+                    if (link_stats.last_recover_ms > link_stats.max_recover_ms) {
+                        link_stats.max_recover_ms = link_stats.last_recover_ms;
+                    }
+                    printf("Network recovered in %lu ms\n", link_stats.last_recover_ms);
+                }
+                sample_link();
+                mqtt_publish_link_status(g_mqtt_ctx, &link_stats);
+            } else if (state == NET_STATE_ONLINE || state == NET_STATE_MQTT_CONNECT) {
+                if (network_wifi_up()) {
+                    // Broker went away or refused us, the address is still good
+                    backoff(NET_STATE_MQTT_CONNECT);
+                } else {
+                    link_lost();
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void network_tick(void) {
+    uint32_t elapsed_ms = now_ms() - state_entered_ms;
+
+    switch (state) {
+        case NET_STATE_WIFI_JOIN: {
+            int link = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+            if (link == CYW43_LINK_UP) {
+                printf("\nConnected to Wifi\n");
+                if (link_was_up) link_stats.reassociations++;
+                link_was_up = true;
+                pm_applied = false;
+                apply_pm_profile();
+                sample_link();
+                start_dns();
+            } else if (link == CYW43_LINK_BADAUTH) {
+                printf("Wi-Fi join failed: invalid credentials\n");
+                backoff(NET_STATE_WIFI_JOIN);
+            } else if (link == CYW43_LINK_FAIL || link == CYW43_LINK_NONET) {
+                printf("Wi-Fi join failed (%d)\n", link);
+                backoff(NET_STATE_WIFI_JOIN);
+            } else if (elapsed_ms > NETWORK_JOIN_TIMEOUT_MS) {
+                printf("Wi-Fi join timed out\n");
+                backoff(NET_STATE_WIFI_JOIN);
+            }
+            break;
+        }
+
+        case NET_STATE_DNS:
+            if (!network_wifi_up()) {
+                link_lost();
+            } else if (elapsed_ms > NETWORK_DNS_TIMEOUT_MS) {
+                printf("DNS lookup of %s timed out\n", MQTT_SERVER);
+                backoff(NET_STATE_DNS);
+            }
+            break;
+
+        case NET_STATE_MQTT_CONNECT:
+            if (!network_wifi_up()) {
+                link_lost();
+            } else if (elapsed_ms > NETWORK_CONNECT_TIMEOUT_MS) {
+                printf("MQTT connect timed out\n");
+                mqtt_abort_connect(g_mqtt_ctx);
+                backoff(NET_STATE_MQTT_CONNECT);
+            }
+            break;
+
+        case NET_STATE_ONLINE:
+            if (!network_wifi_up()) {
+                link_lost();
+            } else {
+                if (now_ms() - last_sample_ms >= NETWORK_LINK_SAMPLE_MS) {
+                    sample_link();
+                }
+                // Keeps the cached address fresh for the next reconnect
+                resolver_refresh(false);
+            }
+            break;
+
+        case NET_STATE_BACKOFF:
+            if (retry_state != NET_STATE_WIFI_JOIN && !network_wifi_up()) {
+                // A lost link has to be rejoined before anything above it can work
+                link_lost();
+            } else if (elapsed_ms >= backoff_ms) {
+                backoff_ms *= 2;
+                if (backoff_ms > NETWORK_BACKOFF_MAX_MS) backoff_ms = NETWORK_BACKOFF_MAX_MS;
+                run_step(retry_state);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+net_state_t network_get_state(void) {
+    return state;
+}
+
+bool network_wifi_up(void) {
+    return state != NET_STATE_OFF &&
+           cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_UP;
+}
+
+const network_link_stats_t* network_get_link_stats(void) {
+    return &link_stats;
+}
+
+const char* network_pm_mode_to_string(uint32_t pm_mode) {
+    switch (pm_mode) {
+        case 0: return "unknown";
+        case CYW43_DEFAULT_PM: return "default";
+        case CYW43_PERFORMANCE_PM: return "performance";
+        case CYW43_AGGRESSIVE_PM: return "aggressive";
+        case CYW43_NONE_PM: return "none";
+        default: return "custom";
+    }
+}
+
+void network_print_stats(void) {
+    printf("Network: %s, rssi %ld dBm (min %ld), pm %s (0x%06lx), %lu joins, %lu losses, "
+           "%lu re-associations, recover last %lu ms max %lu ms\n",
+           network_state_to_string(state),
+           link_stats.rssi_dbm, link_stats.rssi_min_dbm,
+           network_pm_mode_to_string(link_stats.pm_mode), link_stats.pm_mode,
+           link_stats.join_attempts, link_stats.link_losses, link_stats.reassociations,
+           link_stats.last_recover_ms, link_stats.max_recover_ms);
+    printf("  pm profile %s%s, publish latency:\n", network_pm_profile_to_string(pm_profile),
+           pm_override ? " (override)" : "");
+    for (int i = 0; i < NET_PM_PROFILE_COUNT; i++) {
+        const event_latency_t *stats = &publish_latency[i];
+        if (stats->count == 0) continue;
+        printf("    %-12s n=%lu min=%luus avg=%luus max=%luus\n",
+               network_pm_profile_to_string((net_pm_profile_t)i),
+               stats->count, stats->min_us, (uint32_t)(stats->total_us / stats->count), stats->max_us);
+    }
+}
+
+const char* network_state_to_string(net_state_t s) {
+    switch (s) {
+        case NET_STATE_OFF: return "OFF";
+        case NET_STATE_WIFI_JOIN: return "WIFI_JOIN";
+        case NET_STATE_DNS: return "DNS";
+        case NET_STATE_MQTT_CONNECT: return "MQTT_CONNECT";
+        case NET_STATE_ONLINE: return "ONLINE";
+        case NET_STATE_BACKOFF: return "BACKOFF";
+        default: return "UNKNOWN";
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "events.h"
+
+// Background bring-up of Wi-Fi, DNS and MQTT. Nothing here blocks: each step is
+// started and its outcome arrives as a network ring event or is polled on the
+// housekeeping tick. Sensor and alarm events stay queued in their rings while
+// the link is down and are published once MQTT is connected.
+
+#define NETWORK_JOIN_TIMEOUT_MS 30000       // association + DHCP
+#define NETWORK_DNS_TIMEOUT_MS 10000
+#define NETWORK_CONNECT_TIMEOUT_MS 20000    // TCP + TLS handshake + MQTT CONNECT
+#define NETWORK_BACKOFF_MIN_MS 1000
+#define NETWORK_BACKOFF_MAX_MS 60000
+#define NETWORK_LINK_SAMPLE_MS 10000        // RSSI / power-management read-back period
+
+typedef enum {
+    NET_STATE_OFF,              // cyw43 not initialised or start not called yet
+    NET_STATE_WIFI_JOIN,        // association and DHCP in progress
+    NET_STATE_DNS,              // resolving MQTT_SERVER
+    NET_STATE_MQTT_CONNECT,     // TCP/TLS + MQTT CONNECT in progress
+    NET_STATE_ONLINE,
+    NET_STATE_BACKOFF,          // waiting before retrying a failed step
+    NET_STATE_COUNT
+} net_state_t;
+
+// Radio power-management profiles, from lowest latency to lowest power
+typedef enum {
+    NET_PM_PERFORMANCE,         // power save off, no wake-up latency
+    NET_PM_BALANCED,            // SDK default PM2 with 200 ms return-to-sleep
+    NET_PM_SAVE,                // PM2 with 2 s return-to-sleep and DTIM 10 listen interval
+    NET_PM_PROFILE_COUNT
+} net_pm_profile_t;
+
+#define NET_PM_AUTO NET_PM_PROFILE_COUNT    // override value: follow the alarm state again
+
+// Link supervisor telemetry, published on the link topic
+typedef struct {
+    int32_t rssi_dbm;           // last sample, 0 until the first one
+    int32_t rssi_min_dbm;
+    uint32_t pm_mode;           // cyw43 power-management value read back from the chip
+    uint32_t join_attempts;
+    uint32_t link_losses;       // link dropped after it had been up
+    uint32_t reassociations;    // link back up after a loss
+    uint32_t last_recover_ms;   // loss -> MQTT online again
+    uint32_t max_recover_ms;
+} network_link_stats_t;
+
+void network_init(MQTT_CLIENT_DATA_T *mqtt_ctx);
+// Enables STA mode and starts joining, call once cyw43_arch_init() succeeded
+void network_start(void);
+// HUB_EVENT_DNS_RESULT / HUB_EVENT_MQTT_CONNECTION records from EVENT_RING_NETWORK
+void network_handle_event(const event_record_t *event);
+// Timeouts, backoff and link polling, call on every housekeeping tick
+void network_tick(void);
+
+net_state_t network_get_state(void);
+bool network_wifi_up(void);
+const char* network_state_to_string(net_state_t state);
+
+// Picks the profile for an alarm state unless a profile override is active.
+// Safe to call before network_start(), the profile is applied once cyw43 is up.
+void network_apply_alarm_state(alarm_state_t alarm_state);
+// Pins one profile regardless of the alarm state, NET_PM_AUTO releases it
+void network_set_pm_override(net_pm_profile_t profile);
+net_pm_profile_t network_get_pm_profile(void);
+bool network_pm_override_active(void);
+const char* network_pm_profile_to_string(net_pm_profile_t profile);
+// Returns NET_PM_AUTO for "auto", NET_PM_PROFILE_COUNT + 1 if the name is unknown
+net_pm_profile_t network_pm_profile_from_string(const char *name);
+
+// Publish -> completion callback latency, recorded per profile active at publish time.
+// Called from the lwIP callback (IRQ context), single writer per profile.
+void network_record_publish_latency(net_pm_profile_t profile, uint32_t latency_us);
+const event_latency_t* network_get_publish_latency(net_pm_profile_t profile);
+
+const network_link_stats_t* network_get_link_stats(void);
+const char* network_pm_mode_to_string(uint32_t pm_mode);
+void network_print_stats(void);
+
+#endif // NETWORK_H
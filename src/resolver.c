@@ -0,0 +1,165 @@
+#include "resolver.h"
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "lwip/dns.h"
+#include "main.h"
+
+static const char *server_name = NULL;
+
+static ip_addr_t cached_addr;
+static bool cache_valid = false;
+static uint32_t cached_at_ms;
+
+static bool fallback_valid = false;
+static ip_addr_t fallback_addr;
+
+static bool lookup_in_flight = false;
+static uint32_t lookup_started_ms;
+static uint32_t last_failure_ms;
+static bool failed_since_cached = false;
+
+// Written by the lwIP callback before its event is pushed, read when the event is handled
+static ip_addr_t found_addr;
+
+static resolver_stats_t stats;
+
+static inline uint32_t now_ms(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+static void store(const ip_addr_t *addr) {
+    if (cache_valid && !ip_addr_cmp(&cached_addr, addr)) {
+        stats.changes++;
+        printf("MQTT server %s moved to %s\n", server_name, ipaddr_ntoa(addr));
+    }
+    ip_addr_copy(cached_addr, *addr);
+    cache_valid = true;
+    cached_at_ms = now_ms();
+    failed_since_cached = false;
+}
+
+// lwIP context, the main loop picks the result up from the network ring
+static void dns_found(const char *hostname, const ip_addr_t *ipaddr, void *arg) {
+    if (ipaddr) {
+        ip_addr_copy(found_addr, *ipaddr);
+    }
+    events_push(EVENT_RING_NETWORK, HUB_EVENT_DNS_RESULT, 0, ipaddr != NULL, 0);
+}
+
+void resolver_init(const char *hostname) {
+    server_name = hostname;
+    cache_valid = false;
+    lookup_in_flight = false;
+#ifdef MQTT_SERVER_FALLBACK_IP
+    fallback_valid = ipaddr_aton(MQTT_SERVER_FALLBACK_IP, &fallback_addr);
+    if (!fallback_valid) {
+        printf("Ignoring invalid MQTT_SERVER_FALLBACK_IP %s\n", MQTT_SERVER_FALLBACK_IP);
+    }
+#endif
+}
+
+resolver_source_t resolver_get(ip_addr_t *addr) {
+    resolver_source_t source = RESOLVER_SOURCE_NONE;
+
+    if (cache_valid && now_ms() - cached_at_ms < RESOLVER_CACHE_TTL_MS) {
+        source = RESOLVER_SOURCE_DNS;
+    } else if (cache_valid) {
+        // An expired answer is still more likely right than the static address
+        source = RESOLVER_SOURCE_STALE;
+    } else if (fallback_valid) {
+        source = RESOLVER_SOURCE_STATIC;
+    }
+
+    if (source == RESOLVER_SOURCE_DNS || source == RESOLVER_SOURCE_STALE) {
+        ip_addr_copy(*addr, cached_addr);
+    } else if (source == RESOLVER_SOURCE_STATIC) {
+        ip_addr_copy(*addr, fallback_addr);
+    }
+    stats.uses[source]++;
+    return source;
+}
+
+bool resolver_refresh(bool force) {
+    uint32_t now = now_ms();
+
+    if (lookup_in_flight) {
+        if (now - lookup_started_ms < RESOLVER_LOOKUP_TIMEOUT_MS) return true;
+        // lwIP normally reports a timeout itself, do not wait for it forever
+        lookup_in_flight = false;
+        stats.failures++;
+        last_failure_ms = now;
+        failed_since_cached = true;
+    }
+
+    if (!force) {
+        if (cache_valid && now - cached_at_ms < RESOLVER_REFRESH_MS) return false;
+        if (failed_since_cached && now - last_failure_ms < RESOLVER_RETRY_MS) return false;
+    }
+
+    ip_addr_t addr;
+    stats.lookups++;
+    // We are not in a callback so locking is needed when calling lwip
+    cyw43_arch_lwip_begin();
+    err_t err = dns_gethostbyname(server_name, &addr, dns_found, NULL);
+    cyw43_arch_lwip_end();
+
+    if (err == ERR_OK) {
+        // IP literal or in lwIP's own cache, no callback follows
+        store(&addr);
+        return false;
+    }
+    if (err == ERR_INPROGRESS) {
+        lookup_in_flight = true;
+        lookup_started_ms = now;
+        return true;
+    }
+
+    printf("DNS request for %s failed: %d\n", server_name, err);
+    stats.failures++;
+    last_failure_ms = now;
+    failed_since_cached = true;
+    return false;
+}
+
+bool resolver_lookup_pending(void) {
+    return lookup_in_flight;
+}
+
+void resolver_handle_result(const event_record_t *event) {
+    if (!lookup_in_flight) return;  // answer to a lookup already given up on
+    lookup_in_flight = false;
+
+    if (event->level) {
+        store(&found_addr);
+        printf("MQTT server %s is %s\n", server_name, ipaddr_ntoa(&cached_addr));
+    } else {
+        printf("DNS lookup of %s failed\n", server_name);
+        stats.failures++;
+        last_failure_ms = now_ms();
+        failed_since_cached = true;
+    }
+}
+
+const resolver_stats_t* resolver_get_stats(void) {
+    return &stats;
+}
+
+void resolver_print_stats(void) {
+    printf("Resolver: %s -> %s (age %lu s), %lu lookups, %lu failed, %lu changes, used dns %lu stale %lu static %lu\n",
+           server_name,
+           cache_valid ? ipaddr_ntoa(&cached_addr) : "-",
+           cache_valid ? (now_ms() - cached_at_ms) / 1000 : 0,
+           stats.lookups, stats.failures, stats.changes,
+           stats.uses[RESOLVER_SOURCE_DNS], stats.uses[RESOLVER_SOURCE_STALE], stats.uses[RESOLVER_SOURCE_STATIC]);
+}
+
+const char* resolver_source_to_string(resolver_source_t source) {
+    switch (source) {
+        case RESOLVER_SOURCE_NONE: return "NONE";
+        case RESOLVER_SOURCE_DNS: return "DNS";
+        case RESOLVER_SOURCE_STALE: return "STALE";
+        case RESOLVER_SOURCE_STATIC: return "STATIC";
+        default: return "UNKNOWN";
+    }
+}
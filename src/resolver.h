@@ -0,0 +1,51 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lwip/ip_addr.h"
+#include "events.h"
+
+// MQTT server address resolver. Lookups run in the background and the last good
+// answer is cached, so a reconnect never waits on DNS: it uses the cached address
+// (even past its TTL if a refresh failed) or the static MQTT_SERVER_FALLBACK_IP.
+
+// lwIP does not hand the record TTL to the found callback, so the cache uses a fixed one
+#define RESOLVER_CACHE_TTL_MS 300000
+#define RESOLVER_REFRESH_MS (RESOLVER_CACHE_TTL_MS / 2)    // background refresh from here on
+#define RESOLVER_RETRY_MS 30000                             // after a failed lookup
+#define RESOLVER_LOOKUP_TIMEOUT_MS 10000                    // lookup considered lost after this
+
+typedef enum {
+    RESOLVER_SOURCE_NONE,       // nothing to connect to yet
+    RESOLVER_SOURCE_DNS,        // cached answer within its TTL
+    RESOLVER_SOURCE_STALE,      // cached answer past its TTL, refresh failing
+    RESOLVER_SOURCE_STATIC,     // MQTT_SERVER_FALLBACK_IP
+    RESOLVER_SOURCE_COUNT
+} resolver_source_t;
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t failures;
+    uint32_t changes;           // answer differed from the cached address
+    uint32_t uses[RESOLVER_SOURCE_COUNT];
+} resolver_stats_t;
+
+void resolver_init(const char *hostname);
+
+// Best address to connect to right now, never blocks
+resolver_source_t resolver_get(ip_addr_t *addr);
+
+// Starts a lookup if the cache is due for a refresh (or always with force).
+// Returns true while a lookup is in flight, its HUB_EVENT_DNS_RESULT follows.
+bool resolver_refresh(bool force);
+bool resolver_lookup_pending(void);
+
+// HUB_EVENT_DNS_RESULT records from EVENT_RING_NETWORK
+void resolver_handle_result(const event_record_t *event);
+
+const resolver_stats_t* resolver_get_stats(void);
+void resolver_print_stats(void);
+const char* resolver_source_to_string(resolver_source_t source);
+
+#endif // RESOLVER_H
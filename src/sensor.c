@@ -1,115 +1,516 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "pico/time.h"
+#include "hardware/gpio.h"
 #include "sensor.h"
 #include "mcp23018.h"
 #include "alarm.h"
 #include "mqtt.h"
+#include "events.h"
+#include "i2c_async.h"
+#include "i2c_recovery.h"
+#include "main.h"
 
-sensor_manager_t* sensor_manager_init(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm_ctx) {
-    // Get all sensor config from a file maybe?
-    // For now sensors are created here
+static sensor_manager_t *g_sensor_manager = NULL;
 
-    sensor_manager_t *manager = calloc(1, sizeof(sensor_manager_t));
-    if (!manager) return NULL;
+// Expanders on this hub, sensor_config_t.expander indexes this table.
+// Expanders may share an INTA line, it is switched to open-drain for them.
+static const struct {
+    uint8_t addr;
+    uint8_t int_pin;
+} expander_table[] = {
+    { EXPANDER_ADDR, INTERRUPT_PIN },
+};
 
-    sensor_config_t front_door = {
+// Sensors on this hub, grouped by expander. Const so it stays in flash, only
+// sensor_state_t and the per-expander masks are kept in RAM.
+static const sensor_config_t sensor_table[] = {
+    {
         .id = 1,
         .type = SENSOR_TYPE_DOOR,          // This will be cast to uint8_t
+        .expander = 0,
         .mcp_pin_mask = GPA7_PIN,
-        .name = "Front Door",              // Now only 16 chars max
-        .computer_name = "front_door",     // Added computer-readable name
+        .name = "Front Door",              // 16 chars max
+        .computer_name = "front_door",
         .active = true,
         .invert_logic = true,
-        .debounce_ms = 0,                  // Now uint16_t
-        .last_event_time = 0
-    };
+        .debounce_ms = 0,
+    },
+};
+
+// Debounce window per sensor type, used when the descriptor leaves debounce_ms at 0.
+// A change is only reported once the pin still reads the new level after the window.
+static const uint32_t debounce_window_us[SENSOR_TYPE_COUNT] = {
+    [SENSOR_TYPE_DOOR] = 20000,             // reed contacts bounce for a few ms
+    [SENSOR_TYPE_WINDOW] = 20000,
+    [SENSOR_TYPE_MOTION] = 0,               // PIR outputs are clean, report right away
+    [SENSOR_TYPE_SMOKE] = 100000,
+    [SENSOR_TYPE_ARM_BUTTON] = 30000,
+    [SENSOR_TYPE_DISARM_BUTTON] = 30000,
+};
+
+#define EXPANDER_TABLE_COUNT (sizeof(expander_table) / sizeof(expander_table[0]))
+#define SENSOR_TABLE_COUNT (sizeof(sensor_table) / sizeof(sensor_table[0]))
+
+_Static_assert(EXPANDER_TABLE_COUNT <= MAX_EXPANDERS, "too many expanders");
+_Static_assert(SENSOR_TABLE_COUNT <= MAX_SENSORS, "too many sensors");
+
+// Runtime state of every sensor as parallel arrays indexed by sensor index, 8 bytes
+// per configured sensor. Each expander's sensors are contiguous, so one interrupt
+// touches one slice.
+typedef struct {
+    uint32_t edge_us[SENSOR_TABLE_COUNT];       // raw time of the last edge (INTA timestamp)
+    uint16_t event_count[SENSOR_TABLE_COUNT];   // accepted changes since boot
+    uint16_t glitch_count[SENSOR_TABLE_COUNT];  // edges that did not survive the debounce window
+} sensor_state_t;
+
+static sensor_state_t sensor_runtime;
+static sensor_expander_t expander_slots[EXPANDER_TABLE_COUNT];
+
+static void init_expanders(sensor_manager_t *manager) {
+    for (uint8_t i = 0; i < EXPANDER_TABLE_COUNT; i++) {
+        sensor_expander_t *expander = &manager->expanders[i];
+        mcp23018_init(&expander->dev, expander_table[i].addr, expander_table[i].int_pin);
+        memset(expander->pin_sensor, SENSOR_NONE, sizeof(expander->pin_sensor));
+
+        for (uint8_t j = 0; j < EXPANDER_TABLE_COUNT; j++) {
+            if (j != i && expander_table[j].int_pin == expander_table[i].int_pin) {
+                expander->dev.shared_int = true;
+            }
+        }
+        manager->interrupt_pins |= 1ull << expander->dev.int_pin;
+    }
+    manager->expander_count = EXPANDER_TABLE_COUNT;
+}
+
+static bool add_sensor(sensor_manager_t *manager, uint8_t index) {
+    const sensor_config_t *config = &manager->sensors[index];
+    if (config->expander >= manager->expander_count) {
+        printf("Sensor '%s': unknown expander %u\n", config->name, config->expander);
+        return false;
+    }
+
+    sensor_expander_t *expander = &manager->expanders[config->expander];
+    if (expander->sensor_count == 0) {
+        expander->first_sensor = index;
+    } else if (expander->first_sensor + expander->sensor_count != index) {
+        // Keeps each expander's sensors in one contiguous slice
+        printf("Sensor '%s': sensors of expander %u must be listed together\n", config->name, config->expander);
+        return false;
+    }
+    uint16_t mask = config->mcp_pin_mask;
+    if (mask == 0 || (mask & (mask - 1))) {
+        printf("Sensor '%s': pin mask must have exactly one pin set\n", config->name);
+        return false;
+    }
+    if (expander->sensor_mask & mask) {
+        printf("Sensor '%s': pin already used on expander %u\n", config->name, config->expander);
+        return false;
+    }
+
+    expander->pin_sensor[__builtin_ctz(mask)] = index;
+    expander->sensor_mask |= mask;
+    if (config->active) expander->active_mask |= mask;
+    if (config->invert_logic) expander->invert_mask |= mask;
+    expander->sensor_count++;
+    return true;
+}
+
+sensor_manager_t* sensor_manager_init(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm_ctx) {
+    // Get all sensor config from a file maybe?
+    // For now sensors come from the tables above
+
+    sensor_manager_t *manager = calloc(1, sizeof(sensor_manager_t));
+    if (!manager) return NULL;
 
-    manager->sensors[0] = front_door;
-    manager->active_sensor_mask |= front_door.mcp_pin_mask;
     manager->alarm_ctx = alarm_ctx;
     manager->mqtt_ctx = mqtt_ctx;
-    manager->sensor_count = 1;
 
+    manager->expanders = expander_slots;
+    init_expanders(manager);
+    manager->sensors = sensor_table;
+    for (uint8_t i = 0; i < SENSOR_TABLE_COUNT; i++) {
+        // The table is used in place, a bad entry stops it there
+        if (!add_sensor(manager, i)) break;
+        manager->sensor_count++;
+    }
+    printf("Sensor manager: %u sensors on %u expanders\n", manager->sensor_count, manager->expander_count);
+
+    g_sensor_manager = manager;
     return manager;
 }
 
-void sensor_handle_interrupt(sensor_manager_t *manager, uint8_t intf, uint8_t intcap) {
-    if (!manager) return;
-    
-    uint32_t current_time = to_ms_since_boot(get_absolute_time());
-    
-    // Check each sensor to see if it triggered the interrupt
-    for (int i = 0; i < manager->sensor_count; i++) {
-        sensor_config_t *sensor = &manager->sensors[i];
-        
-        if (!sensor->active) continue;
-        
-        // Check if this sensor's pin caused the interrupt
-        if (intf & sensor->mcp_pin_mask) {
-            // Get the current state from the interrupt capture register
-            bool pin_state = (intcap & sensor->mcp_pin_mask) ? true : false;
+const sensor_config_t* sensor_get(uint8_t index) {
+    if (!g_sensor_manager || index >= g_sensor_manager->sensor_count) return NULL;
+    return &g_sensor_manager->sensors[index];
+}
+
+uint8_t sensor_index(const sensor_config_t *sensor) {
+    if (!g_sensor_manager || !sensor) return SENSOR_NONE;
+    return (uint8_t)(sensor - g_sensor_manager->sensors);
+}
+
+bool sensor_get_level(uint8_t index) {
+    const sensor_config_t *sensor = sensor_get(index);
+    if (!sensor) return false;
+    const sensor_expander_t *expander = &g_sensor_manager->expanders[sensor->expander];
+    return (expander->level & sensor->mcp_pin_mask) != 0;
+}
+
+uint16_t sensor_get_event_count(uint8_t index) {
+    if (!sensor_get(index)) return 0;
+    return sensor_runtime.event_count[index];
+}
+
+uint16_t sensor_get_glitch_count(uint8_t index) {
+    if (!sensor_get(index)) return 0;
+    return sensor_runtime.glitch_count[index];
+}
+
+static uint32_t sensor_debounce_us(const sensor_config_t *sensor) {
+    if (sensor->debounce_ms) return sensor->debounce_ms * 1000u;
+    return sensor->type < SENSOR_TYPE_COUNT ? debounce_window_us[sensor->type] : 0;
+}
+
+// Clear anything latched while the pins were being configured (INTCAP read)
+// and take the current pin levels as the reported state
+static void sync_levels(sensor_expander_t *expander) {
+    uint8_t regs[4];    // INTCAPA, INTCAPB, GPIOA, GPIOB
+    if (i2c_async_read_blocking(expander->dev.addr, MCP23018_INTCAPA, regs, sizeof(regs)) == sizeof(regs)) {
+        uint16_t gpio = (uint16_t)(regs[2] | (regs[3] << 8));
+        expander->level = (gpio ^ expander->invert_mask) & expander->sensor_mask;
+    }
+    expander->debounce_pending = 0;
+}
+
+int sensor_configure_expanders(sensor_manager_t *manager) {
+    int configured = 0;
+    for (uint8_t i = 0; i < manager->expander_count; i++) {
+        sensor_expander_t *expander = &manager->expanders[i];
+        if (mcp23018_configure_inputs(&expander->dev, expander->sensor_mask) < 0) continue;
+        sync_levels(expander);
+
+        printf("MCP23018 0x%02x: sensor pins 0x%04x, INTA on GP%u%s\n",
+               expander->dev.addr, expander->sensor_mask, expander->dev.int_pin,
+               expander->dev.shared_int ? " (shared)" : "");
+        configured++;
+    }
+    return configured;
+}
+
+int sensor_restore_expanders(sensor_manager_t *manager) {
+    int restored = 0;
+    for (uint8_t i = 0; i < manager->expander_count; i++) {
+        sensor_expander_t *expander = &manager->expanders[i];
+        // A capture or re-sample lost in the reset must not block the next one
+        expander->capture_in_flight = false;
+        expander->recapture_needed = false;
+        expander->resample_in_flight = false;
+        if (mcp23018_restore(&expander->dev) < 0) continue;
+        sync_levels(expander);
+
+        printf("MCP23018 0x%02x: configuration restored in %luus\n",
+               expander->dev.addr, expander->dev.last_restore_us);
+        restored++;
+    }
+    return restored;
+}
+
+static bool expanders_healthy(void *ctx) {
+    sensor_manager_t *manager = (sensor_manager_t *)ctx;
+    for (uint8_t i = 0; i < manager->expander_count; i++) {
+        if (!mcp23018_probe(&manager->expanders[i].dev)) return false;
+    }
+    return true;
+}
+
+static bool reset_expanders(void *ctx) {
+    sensor_manager_t *manager = (sensor_manager_t *)ctx;
+    // The reset line is shared, every expander comes back with power-on defaults
+    mcp23018_hardware_reset();
+    return sensor_restore_expanders(manager) == manager->expander_count;
+}
+
+bool sensor_recover_bus(sensor_manager_t *manager) {
+    return i2c_recovery_run(expanders_healthy, reset_expanders, manager) >= 0;
+}
+
+// Runs in I2C IRQ context once an expander's interrupt burst read has finished
+static void capture_done(int result, void *user_data) {
+    sensor_expander_t *expander = (sensor_expander_t *)user_data;
+    expander->capture_in_flight = false;
+    uint8_t index = (uint8_t)(expander - g_sensor_manager->expanders);
+    events_push(EVENT_RING_I2C, HUB_EVENT_MCP_CAPTURE, index, 0, (uint32_t)result);
+}
+
+static void start_capture(sensor_expander_t *expander, uint32_t edge_us) {
+    // INTFA, INTFB, INTCAPA, INTCAPB, GPIOA, GPIOB in one sequential read
+    expander->capture_in_flight = true;
+    expander->edge_us = edge_us;
+    if (!mcp23018_read_interrupt_async(&expander->dev, &expander->capture, capture_done, expander)) {
+        expander->capture_in_flight = false;
+        printf("I2C queue full, interrupt capture of 0x%02x not read\n", expander->dev.addr);
+    }
+}
+
+void sensor_service_interrupt_line(sensor_manager_t *manager, uint gpio, uint64_t edge_us) {
+    for (uint8_t i = 0; i < manager->expander_count; i++) {
+        sensor_expander_t *expander = &manager->expanders[i];
+        if (expander->dev.int_pin != gpio) continue;
+
+        // The edge may have come after the queued read got past INTCAP, in which case
+        // INTA stays low and, being falling-edge only, never interrupts again.
+        // sensor_handle_capture() reads once more if the line is still low.
+        if (expander->capture_in_flight) {
+            if (!expander->recapture_needed) {
+                expander->recapture_needed = true;
+                expander->recapture_edge_us = (uint32_t)edge_us;
+            }
+            continue;
+        }
+
+        // On a shared line every expander is read, the ones that did not assert
+        // INTA just report INTF = 0
+        start_capture(expander, (uint32_t)edge_us);
+    }
+}
+
+bool sensor_handle_capture(sensor_manager_t *manager, const event_record_t *event) {
+    if (event->pin >= manager->expander_count) return true;
+
+    sensor_expander_t *expander = &manager->expanders[event->pin];
+    int read_result = (int)event->data;
+    if (read_result != sizeof(expander->capture)) {
+        expander->capture_errors++;
+        printf("Failed to read interrupt capture of 0x%02x (error: %d)\n", expander->dev.addr, read_result);
+        return false;
+    }
+
+    const mcp23018_int_capture_t *capture = &expander->capture;
+    if (capture->intfa || capture->intfb) {
+        printf("0x%02x INTF: 0x%02x/0x%02x, INTCAP: 0x%02x/0x%02x, GPIO: 0x%02x/0x%02x (interrupt cleared)\n",
+               expander->dev.addr,
+               capture->intfa, capture->intfb,
+               capture->intcapa, capture->intcapb,
+               capture->gpioa, capture->gpiob);
+    }
+
+    sensor_handle_interrupt(manager, expander);
+
+    // INTA still asserted: a change latched after this capture's INTCAP read. On a
+    // shared line only an expander that took part re-reads, so a neighbour holding
+    // the line low cannot keep it polling.
+    bool took_part = expander->recapture_needed || capture->intfa || capture->intfb;
+    if (took_part && !gpio_get(expander->dev.int_pin) && !expander->capture_in_flight) {
+        uint32_t edge_us = expander->recapture_needed ? expander->recapture_edge_us : time_us_32();
+        expander->recapture_needed = false;
+        start_capture(expander, edge_us);
+    } else {
+        expander->recapture_needed = false;
+    }
+    return true;
+}
+
+static void report_change(sensor_manager_t *manager, sensor_expander_t *expander, uint8_t pin, bool sensor_state) {
+    uint8_t i = expander->pin_sensor[pin];
+    const sensor_config_t *sensor = &manager->sensors[i];
+
+    sensor_runtime.event_count[i]++;
+    if (sensor_state) {
+        expander->level |= (uint16_t)(1u << pin);
+    } else {
+        expander->level &= (uint16_t)~(1u << pin);
+    }
+
+    // Handle different sensor types
+    switch ((sensor_type_t)sensor->type) {
+        case SENSOR_TYPE_DOOR:
+            printf("Door sensor '%s' %s\n", sensor->name, sensor_state ? "opened" : "closed");
+            
+            // Queue for MQTT publishing, every edge is kept in order
+            manager->alarm_ctx->triggered_sensor = sensor;
+            if (!events_push(EVENT_RING_SENSOR, HUB_EVENT_SENSOR_CHANGED, pin, sensor_state, i)) {
+                printf("Sensor event ring full, door event for '%s' dropped\n", sensor->name);
+            }
+
+            // Update alarm system - only trigger if armed and door opened
+            if (sensor_state && alarm_is_armed(manager->alarm_ctx)) {
+                printf("Door opened while armed - triggering alarm!\n");
+                //alarm_post_event(EVENT_TRIGGER);
+                alarm_post_event(EVENT_ENTRY_DELAY);
+            } else if (sensor_state) {
+                printf("Door opened while disarmed - no alarm\n");
+            }
+            break;
             
-            // Apply invert logic if needed
-            bool sensor_state = sensor->invert_logic ? !pin_state : pin_state;
+        case SENSOR_TYPE_WINDOW:
+            printf("Window sensor '%s' %s\n", sensor->name, sensor_state ? "opened" : "closed");
+            // Add window-specific handling here
+            break;
             
-            // Check debouncing
-            if (current_time - sensor->last_event_time < sensor->debounce_ms) {
-                printf("Sensor %s: debounced (too soon)\n", sensor->name);
-                continue;
+        case SENSOR_TYPE_MOTION:
+            printf("Motion sensor '%s' %s\n", sensor->name, sensor_state ? "motion detected" : "motion cleared");
+            // Add motion-specific handling here
+            break;
+            
+        case SENSOR_TYPE_ARM_BUTTON:
+            if (sensor_state) {
+                printf("ARM button '%s' pressed\n", sensor->name);
+                alarm_post_event(EVENT_ARM);
             }
+            break;
             
-            // Handle different sensor types
-            switch ((sensor_type_t)sensor->type) {
-                case SENSOR_TYPE_DOOR:
-                    printf("Door sensor '%s' %s\n", sensor->name, sensor_state ? "opened" : "closed");
-                    
-                    // Publish to MQTT
-                    //mqtt_publish_door_state(*manager->mqtt_ctx, sensor_state, sensor->computer_name);
-                    manager->alarm_ctx->triggered_sensor = sensor;
-                    mqtt_flags.last_door_sensor = sensor;
-                    mqtt_flags.last_door_state = sensor_state;
-                    mqtt_flags.door_state_changed = true;
-
-                    // Update alarm system - only trigger if armed and door opened
-                    if (sensor_state && alarm_is_armed(manager->alarm_ctx)) {
-                        printf("Door opened while armed - triggering alarm!\n");
-                        //update_alarm_state(manager->alarm_ctx, EVENT_TRIGGER);
-                        update_alarm_state(manager->alarm_ctx, EVENT_ENTRY_DELAY);
-                    } else if (sensor_state) {
-                        printf("Door opened while disarmed - no alarm\n");
-                    }
-                    break;
-                    
-                case SENSOR_TYPE_WINDOW:
-                    printf("Window sensor '%s' %s\n", sensor->name, sensor_state ? "opened" : "closed");
-                    // Add window-specific handling here
-                    break;
-                    
-                case SENSOR_TYPE_MOTION:
-                    printf("Motion sensor '%s' %s\n", sensor->name, sensor_state ? "motion detected" : "motion cleared");
-                    // Add motion-specific handling here
-                    break;
-                    
-                case SENSOR_TYPE_ARM_BUTTON:
-                    if (sensor_state) {
-                        printf("ARM button '%s' pressed\n", sensor->name);
-                        update_alarm_state(manager->alarm_ctx, EVENT_ARM);
-                    }
-                    break;
-                    
-                case SENSOR_TYPE_DISARM_BUTTON:
-                    if (sensor_state) {
-                        printf("DISARM button '%s' pressed\n", sensor->name);
-                        update_alarm_state(manager->alarm_ctx, EVENT_DISARM);
-                    }
-                    break;
-                    
-                default:
-                    printf("Unknown sensor type %d for '%s'\n", sensor->type, sensor->name);
-                    break;
+        case SENSOR_TYPE_DISARM_BUTTON:
+            if (sensor_state) {
+                printf("DISARM button '%s' pressed\n", sensor->name);
+                alarm_post_event(EVENT_DISARM);
             }
+            break;
+            
+        default:
+            printf("Unknown sensor type %d for '%s'\n", sensor->type, sensor->name);
+            break;
+    }
+}
+
+// Runs in the timer IRQ, the re-sample itself is queued from the main loop
+static int64_t debounce_alarm_callback(alarm_id_t id, void *user_data) {
+    sensor_expander_t *expander = (sensor_expander_t *)user_data;
+    uint8_t index = (uint8_t)(expander - g_sensor_manager->expanders);
+    events_push(EVENT_RING_TIMER, HUB_EVENT_DEBOUNCE_DUE, index, 0, (uint32_t)id);
+    return 0;
+}
+
+// One alarm per expander covers every pin waiting on it, it fires at the earliest deadline
+static void schedule_resample(sensor_expander_t *expander, uint32_t deadline_us) {
+    if (expander->resample_scheduled && (int32_t)(deadline_us - expander->resample_at_us) >= 0) {
+        return;
+    }
+    if (expander->resample_scheduled) {
+        cancel_alarm(expander->resample_alarm);
+    }
+
+    int32_t delay_us = (int32_t)(deadline_us - time_us_32());
+    if (delay_us < 100) delay_us = 100;
+
+    alarm_id_t id = add_alarm_in_us(delay_us, debounce_alarm_callback, expander, true);
+    expander->resample_scheduled = id > 0;
+    if (id > 0) {
+        expander->resample_alarm = id;
+        expander->resample_at_us = deadline_us;
+    } else {
+        printf("No alarm slot for debounce re-sample of 0x%02x\n", expander->dev.addr);
+    }
+}
+
+void sensor_handle_interrupt(sensor_manager_t *manager, sensor_expander_t *expander) {
+    if (!manager || !expander) return;
+
+    // Only the pins that actually flagged the interrupt
+    uint16_t intf = mcp23018_capture_intf(&expander->capture);
+    uint16_t intcap = mcp23018_capture_intcap(&expander->capture);
+    uint16_t pending = intf & expander->active_mask;
+    if (!pending) return;
+    // Logical sensor states for the whole expander in one go
+    uint16_t states = intcap ^ expander->invert_mask;
+    sensor_state_t *state = &sensor_runtime;
+    
+    // Walk only the pins that changed, through the pin -> sensor table, so the
+    // cost is O(changed pins) no matter how many sensors the expander has
+    while (pending) {
+        uint8_t pin = (uint8_t)__builtin_ctz(pending);
+        pending &= pending - 1;     // clear the lowest set bit
+
+        uint8_t i = expander->pin_sensor[pin];
+        uint32_t window_us = sensor_debounce_us(&manager->sensors[i]);
+
+        // Every edge restarts the window, the level has to hold for all of it
+        state->edge_us[i] = expander->edge_us;
+        if (window_us == 0) {
+            report_change(manager, expander, pin, (states >> pin) & 1);
+        } else {
+            expander->debounce_pending |= (uint16_t)(1u << pin);
+            schedule_resample(expander, expander->edge_us + window_us);
+        }
+    }
+}
+
+// Runs in I2C IRQ context once the debounce re-sample read has finished
+static void resample_done(int result, void *user_data) {
+    sensor_expander_t *expander = (sensor_expander_t *)user_data;
+    expander->resample_in_flight = false;
+    uint8_t index = (uint8_t)(expander - g_sensor_manager->expanders);
+    events_push(EVENT_RING_I2C, HUB_EVENT_MCP_RESAMPLE, index, 0, (uint32_t)result);
+}
+
+void sensor_debounce_due(sensor_manager_t *manager, const event_record_t *event) {
+    if (event->pin >= manager->expander_count) return;
+
+    sensor_expander_t *expander = &manager->expanders[event->pin];
+    // Ignore an alarm that fired just before it was cancelled and replaced
+    if (!expander->resample_scheduled || (alarm_id_t)event->data != expander->resample_alarm) return;
+    expander->resample_scheduled = false;
+
+    if (expander->resample_in_flight) return;
+    expander->resample_in_flight = true;
+    if (!mcp23018_read_async(&expander->dev, MCP23018_GPIOA, expander->sample, sizeof(expander->sample),
+                             resample_done, expander)) {
+        expander->resample_in_flight = false;
+        // Try again shortly rather than leaving the pins pending until the next edge
+        schedule_resample(expander, time_us_32() + 1000);
+    }
+}
+
+bool sensor_handle_resample(sensor_manager_t *manager, const event_record_t *event) {
+    if (event->pin >= manager->expander_count) return true;
+
+    sensor_expander_t *expander = &manager->expanders[event->pin];
+    int read_result = (int)event->data;
+    if (read_result != sizeof(expander->sample)) {
+        expander->capture_errors++;
+        printf("Failed to re-sample 0x%02x (error: %d)\n", expander->dev.addr, read_result);
+        schedule_resample(expander, time_us_32() + 1000);
+        return false;
+    }
+
+    sensor_state_t *state = &sensor_runtime;
+    uint16_t states = (uint16_t)(expander->sample[0] | (expander->sample[1] << 8)) ^ expander->invert_mask;
+    uint32_t now_us = time_us_32();
+    uint16_t pending = expander->debounce_pending;
+
+    while (pending) {
+        uint8_t pin = (uint8_t)__builtin_ctz(pending);
+        uint16_t bit = (uint16_t)(1u << pin);
+        pending &= pending - 1;
+
+        uint8_t i = expander->pin_sensor[pin];
+        uint32_t deadline_us = state->edge_us[i] + sensor_debounce_us(&manager->sensors[i]);
+        if ((int32_t)(now_us - deadline_us) < 0) {
+            // Bounced again after the re-sample was scheduled
+            schedule_resample(expander, deadline_us);
+            continue;
+        }
+
+        expander->debounce_pending &= (uint16_t)~bit;
+        bool sensor_state = states & bit;
+        if (sensor_state != ((expander->level & bit) != 0)) {
+            report_change(manager, expander, pin, sensor_state);
+        } else {
+            // Back at the reported level once the window ended
+            state->glitch_count[i]++;
+            printf("Sensor %s: glitch suppressed (%u so far)\n", manager->sensors[i].name, state->glitch_count[i]);
         }
     }
+    return true;
 }
 
+void sensor_print_stats(const sensor_manager_t *manager) {
+    for (uint8_t i = 0; i < manager->sensor_count; i++) {
+        printf("  %-16s %s, %u changes, %u glitches\n",
+               manager->sensors[i].name,
+               sensor_get_level(i) ? "on" : "off",
+               sensor_runtime.event_count[i],
+               sensor_runtime.glitch_count[i]);
+    }
+}
@@ -4,8 +4,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "common.h"
+#include "mcp23018.h"
+#include "events.h"
 
-#define MAX_SENSORS 4
+#define MAX_EXPANDERS MCP23018_MAX_DEVICES
+#define MAX_SENSORS (MAX_EXPANDERS * MCP23018_PIN_COUNT)
+#define SENSOR_NONE 0xFF            // pin_sensor entry for a pin without a sensor
 
 typedef enum {
     SENSOR_TYPE_DOOR,
@@ -14,6 +18,7 @@ typedef enum {
     SENSOR_TYPE_SMOKE,
     SENSOR_TYPE_ARM_BUTTON,
     SENSOR_TYPE_DISARM_BUTTON,
+    SENSOR_TYPE_COUNT
 } sensor_type_t;
 
 // Sensor event types
@@ -28,17 +33,68 @@ typedef enum {
     SENSOR_EVENT_BUTTON_RELEASED,
 } sensor_event_t;
 
-// Sensor manager structure
+// Everything needed to service one expander's interrupt. Its sensors are a
+// contiguous slice of sensors[], so handling a capture never walks other devices.
+typedef struct __attribute__((aligned(32))) {
+    mcp23018_t dev;
+    uint16_t sensor_mask;               // pins with a sensor, bits 8-15 are port B
+    uint8_t first_sensor;               // slice of sensor_manager_t.sensors
+    uint8_t sensor_count;
+    uint8_t pin_sensor[MCP23018_PIN_COUNT];  // pin -> sensor index, port B at 8-15
+    uint16_t active_mask;               // sensors that are enabled
+    uint16_t invert_mask;               // sensors with inverted logic
+    uint16_t level;                     // last reported sensor state (after inversion)
+    uint16_t debounce_pending;          // pins waiting for their re-sample
+    uint32_t edge_us;                   // INTA edge time of the capture in flight
+    uint32_t resample_at_us;            // deadline of the scheduled re-sample
+    alarm_id_t resample_alarm;
+    bool resample_scheduled;
+    volatile bool resample_in_flight;
+    uint8_t sample[2];                  // GPIOA, GPIOB from the re-sample read
+    mcp23018_int_capture_t capture;     // last INTF/INTCAP/GPIO burst, written by the I2C IRQ
+    volatile bool capture_in_flight;
+    bool recapture_needed;              // an INTA edge arrived while the capture was in flight
+    uint32_t recapture_edge_us;         // time of that edge
+    uint32_t capture_errors;
+} sensor_expander_t;
+
+// Sensor manager structure. The expanders and the per-sensor runtime state live in
+// sensor.c, sized from its tables rather than MAX_EXPANDERS / MAX_SENSORS.
 typedef struct {
-    sensor_config_t sensors[MAX_SENSORS];
+    sensor_expander_t *expanders;       // expander_count entries, 96 bytes each
+    uint8_t expander_count;
+    uint64_t interrupt_pins;            // GPIO bitmask of all expander INTA lines
+    const sensor_config_t *sensors;     // descriptor table in flash, grouped by expander
     uint8_t sensor_count;
-    uint8_t active_sensor_mask;    // Bitmask of which MCP pins have sensors
     MQTT_CLIENT_DATA_T* mqtt_ctx;
     alarm_context_t* alarm_ctx;    // Changed to pointer to work with current code
 } sensor_manager_t;
 
 // Function prototypes
 sensor_manager_t* sensor_manager_init(MQTT_CLIENT_DATA_T *mqtt_ctx, alarm_context_t *alarm_ctx);
-void sensor_handle_interrupt(sensor_manager_t *manager, uint8_t intf, uint8_t intcap);
+// Applies IOCON, direction and interrupt enables to every expander, returns the number configured
+int sensor_configure_expanders(sensor_manager_t *manager);
+// Replays every expander's register shadow after a reset, returns the number restored
+int sensor_restore_expanders(sensor_manager_t *manager);
+// Runs the I2C recovery ladder against all expanders, false if the bus stayed broken
+bool sensor_recover_bus(sensor_manager_t *manager);
+// Queue the interrupt burst read for every expander wired to this INTA line
+// edge_us is the INTA edge timestamp from the GPIO IRQ
+void sensor_service_interrupt_line(sensor_manager_t *manager, uint gpio, uint64_t edge_us);
+// Handles a HUB_EVENT_MCP_CAPTURE record, returns false if the burst read failed
+bool sensor_handle_capture(sensor_manager_t *manager, const event_record_t *event);
+void sensor_handle_interrupt(sensor_manager_t *manager, sensor_expander_t *expander);
+// HUB_EVENT_DEBOUNCE_DUE: queue the GPIO re-sample of that expander
+void sensor_debounce_due(sensor_manager_t *manager, const event_record_t *event);
+// Handles a HUB_EVENT_MCP_RESAMPLE record, returns false if the read failed
+bool sensor_handle_resample(sensor_manager_t *manager, const event_record_t *event);
+void sensor_print_stats(const sensor_manager_t *manager);
+const sensor_config_t* sensor_get(uint8_t index);
+// Index of a sensor in the manager's table, SENSOR_NONE for NULL
+uint8_t sensor_index(const sensor_config_t *sensor);
+// Runtime state, out of range indices read as 0
+bool sensor_get_level(uint8_t index);
+uint16_t sensor_get_event_count(uint8_t index);
+uint16_t sensor_get_glitch_count(uint8_t index);
 
 #endif // SENSOR_H
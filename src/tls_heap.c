@@ -0,0 +1,57 @@
+#include "tls_heap.h"
+#include <stdlib.h>
+#include <string.h>
+#include "mbedtls/platform.h"
+
+// Keeps the returned block 8-byte aligned: size, then a tag marking our blocks
+#define TLS_HEAP_HEADER 8
+#define TLS_HEAP_TAG 0x544C5348     // "TLSH"
+
+static uint32_t in_use = 0;
+static uint32_t peak = 0;
+static uint32_t foreign_frees = 0;
+
+static void *tls_heap_calloc(size_t count, size_t size) {
+    if (size && count > (SIZE_MAX - TLS_HEAP_HEADER) / size) return NULL;
+    size_t bytes = count * size;
+
+    uint8_t *block = malloc(TLS_HEAP_HEADER + bytes);
+    if (!block) return NULL;
+    memset(block + TLS_HEAP_HEADER, 0, bytes);
+    ((uint32_t *)block)[0] = (uint32_t)bytes;
+    ((uint32_t *)block)[1] = TLS_HEAP_TAG;
+
+    in_use += (uint32_t)bytes;
+    if (in_use > peak) peak = in_use;
+    return block + TLS_HEAP_HEADER;
+}
+
+static void tls_heap_free(void *ptr) {
+    if (!ptr) return;
+    uint8_t *block = (uint8_t *)ptr - TLS_HEAP_HEADER;
+    if (((uint32_t *)block)[1] != TLS_HEAP_TAG) {
+        // Allocated by lwIP before the hooks were installed, its heap owns the block.
+        // Only the config holds such blocks and it lives as long as the firmware.
+        foreign_frees++;
+        return;
+    }
+    ((uint32_t *)block)[1] = 0;
+    in_use -= ((uint32_t *)block)[0];
+    free(block);
+}
+
+void tls_heap_init(void) {
+    mbedtls_platform_set_calloc_free(tls_heap_calloc, tls_heap_free);
+}
+
+void tls_heap_reset_peak(void) {
+    peak = in_use;
+}
+
+uint32_t tls_heap_in_use(void) {
+    return in_use;
+}
+
+uint32_t tls_heap_peak(void) {
+    return peak;
+}
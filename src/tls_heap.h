@@ -0,0 +1,19 @@
+#ifndef TLS_HEAP_H
+#define TLS_HEAP_H
+
+#include <stdint.h>
+
+// mbedtls allocation hooks (MBEDTLS_PLATFORM_MEMORY). Every block carries its size
+// so the bytes in use and the peak since the last reset can be tracked. mbedtls
+// runs in the lwIP context or under cyw43_arch_lwip_begin(), never concurrently.
+
+// Installs the hooks. Call after the TLS config is created: lwIP's
+// altcp_tls_create_config_*() installs its own allocator (ALTCP_MBEDTLS_PLATFORM_ALLOC)
+// and would replace these. Blocks lwIP allocated for the config are recognised and
+// left alone if they are ever freed through the hooks.
+void tls_heap_init(void);
+void tls_heap_reset_peak(void);
+uint32_t tls_heap_in_use(void);
+uint32_t tls_heap_peak(void);
+
+#endif // TLS_HEAP_H
@@ -0,0 +1,100 @@
+#include "topics.h"
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "mqtt.h"
+#include "sensor.h"
+
+#define TOPIC_DOOR_PREFIX SENSOR_ROOT_TOPIC "/" DEVICE_NAME "/door/"
+#define TOPIC_NO_DOOR 0xFFFF
+
+// Room for both topics of every sensor with a full-length computer_name, so no door
+// can end up without topics: 96 bytes per sensor, 12 KB at MAX_SENSORS = 128
+#define TOPIC_DOOR_NAME_MAX sizeof(((sensor_config_t *)0)->computer_name)
+#define TOPIC_DOOR_MAX_BYTES (2 * (sizeof(TOPIC_DOOR_PREFIX) - 1 + TOPIC_DOOR_NAME_MAX) + \
+                              sizeof("/closed") + sizeof("/open"))
+#define TOPICS_POOL_SIZE (MAX_SENSORS * TOPIC_DOOR_MAX_BYTES)
+
+_Static_assert(TOPICS_POOL_SIZE < TOPIC_NO_DOOR, "door topic offsets are 16 bit");
+
+// Both string tables are const so they live in flash
+static const char *const topic_table[TOPIC_COUNT] = {
+    [TOPIC_NONE] = "",
+    [TOPIC_HEARTBEAT] = MQTT_FULL_TOPIC_HEARTBEAT,
+    [TOPIC_COMMAND] = MQTT_FULL_TOPIC_COMMAND,
+    [TOPIC_COMMAND_RESPONSE] = MQTT_FULL_TOPIC_COMMAND_RESPONSE,
+    [TOPIC_STATUS] = MQTT_FULL_TOPIC_STATUS,
+    [TOPIC_STATUS_RESPONSE] = MQTT_FULL_TOPIC_STATUS_RESPONSE,
+    [TOPIC_ERROR] = MQTT_FULL_TOPIC_ERROR,
+    [TOPIC_LINK] = MQTT_FULL_TOPIC_LINK,
+    [TOPIC_ALARM_TRIGGERED] = MQTT_FULL_TOPIC_ALARM "/triggered",
+    [TOPIC_ALARM_DISARMED] = MQTT_FULL_TOPIC_ALARM "/disarmed",
+    [TOPIC_ALARM_ARMED] = MQTT_FULL_TOPIC_ALARM "/armed",
+    [TOPIC_FORMAT] = MQTT_FULL_TOPIC_FORMAT,
+};
+
+// Inbound topics we subscribe to, checked once per incoming publish
+static const topic_id_t subscribed[] = {
+    TOPIC_COMMAND,
+};
+
+static char door_pool[TOPICS_POOL_SIZE];
+static uint16_t door_topic[MAX_SENSORS][2];    // pool offsets, [closed, open]
+
+// Appends prefix + name + suffix to the pool, returns its offset or TOPIC_NO_DOOR
+static uint16_t intern_door(uint16_t *used, const char *name, const char *suffix) {
+    size_t prefix_len = sizeof(TOPIC_DOOR_PREFIX) - 1;
+    size_t name_len = strnlen(name, sizeof(((sensor_config_t *)0)->computer_name));
+    size_t suffix_len = strlen(suffix);
+    size_t len = prefix_len + name_len + suffix_len + 1;
+    if (*used + len > sizeof(door_pool)) return TOPIC_NO_DOOR;
+
+    uint16_t offset = *used;
+    char *dst = &door_pool[offset];
+    memcpy(dst, TOPIC_DOOR_PREFIX, prefix_len);
+    memcpy(dst + prefix_len, name, name_len);
+    memcpy(dst + prefix_len + name_len, suffix, suffix_len + 1);
+    *used += (uint16_t)len;
+    return offset;
+}
+
+void topics_init(void) {
+    uint16_t used = 0;
+    uint8_t doors = 0;
+
+    for (int i = 0; i < MAX_SENSORS; i++) {
+        door_topic[i][0] = door_topic[i][1] = TOPIC_NO_DOOR;
+
+        const sensor_config_t *sensor = sensor_get((uint8_t)i);
+        if (!sensor || sensor->type != SENSOR_TYPE_DOOR) continue;
+
+        door_topic[i][0] = intern_door(&used, sensor->computer_name, "/closed");
+        door_topic[i][1] = intern_door(&used, sensor->computer_name, "/open");
+        if (door_topic[i][0] == TOPIC_NO_DOOR || door_topic[i][1] == TOPIC_NO_DOOR) {
+            // Cannot happen with the pool sized above, but never publish half a pair
+            printf("ERROR: topic pool full, no door topics for '%s'\n", sensor->name);
+            continue;
+        }
+        doors++;
+    }
+    printf("Topics: %d fixed, %u door sensors in %u/%u bytes\n", TOPIC_COUNT - 1, doors, used,
+           (unsigned)TOPICS_POOL_SIZE);
+}
+
+const char* topics_get(topic_id_t id) {
+    if ((unsigned)id >= TOPIC_COUNT) return topic_table[TOPIC_NONE];
+    return topic_table[id];
+}
+
+const char* topics_door(uint8_t sensor_index, bool open) {
+    if (sensor_index >= MAX_SENSORS) return NULL;
+    uint16_t offset = door_topic[sensor_index][open ? 1 : 0];
+    return offset == TOPIC_NO_DOOR ? NULL : &door_pool[offset];
+}
+
+topic_id_t topics_match(const char *topic) {
+    for (size_t i = 0; i < sizeof(subscribed) / sizeof(subscribed[0]); i++) {
+        if (strcmp(topic, topic_table[subscribed[i]]) == 0) return subscribed[i];
+    }
+    return TOPIC_NONE;
+}
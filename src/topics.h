@@ -0,0 +1,39 @@
+#ifndef TOPICS_H
+#define TOPICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Interned MQTT topic strings. The fixed topics are concatenated at compile time
+// and live in flash, the per-sensor door topics are built once by topics_init()
+// into a packed pool. Publishers pass these pointers straight through the publish
+// queue, so a topic is never formatted or copied at publish time.
+
+typedef enum {
+    TOPIC_NONE,                 // not one of ours
+    TOPIC_HEARTBEAT,            // also the will topic
+    TOPIC_COMMAND,
+    TOPIC_COMMAND_RESPONSE,
+    TOPIC_STATUS,
+    TOPIC_STATUS_RESPONSE,
+    TOPIC_ERROR,
+    TOPIC_LINK,
+    TOPIC_ALARM_TRIGGERED,
+    TOPIC_ALARM_DISARMED,
+    TOPIC_ALARM_ARMED,
+    TOPIC_FORMAT,               // retained payload format flag
+    TOPIC_COUNT
+} topic_id_t;
+
+// Builds the door topics for every door sensor, call after sensor_manager_init()
+void topics_init(void);
+
+const char* topics_get(topic_id_t id);
+
+// <root>/<device>/door/<computer_name>/open|closed, NULL if the sensor is not a door
+const char* topics_door(uint8_t sensor_index, bool open);
+
+// Maps an inbound topic to its id, TOPIC_NONE if it is not subscribed
+topic_id_t topics_match(const char *topic);
+
+#endif // TOPICS_H
@@ -0,0 +1,63 @@
+// Cost of the table-driven alarm state machine on the host: the raw table lookup,
+// an ignored event and a full transition (hooks, change event and log line).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alarm.h"
+#include "host_fakes.h"
+
+#define LOOKUP_ROUNDS 2000000
+#define UPDATE_ROUNDS 1000000
+
+// ARMED -> DISARMED -> ARMING -> ARMED -> TRIGGERING -> TRIGGERED -> ARMED
+static const alarm_event_t cycle[] = {
+    EVENT_DISARM, EVENT_EXIT_DELAY, EVENT_EXIT_DELAY_EXPIRED,
+    EVENT_ENTRY_DELAY, EVENT_ENTRY_DELAY_EXPIRED, EVENT_RESET,
+};
+#define CYCLE_LEN (sizeof(cycle) / sizeof(cycle[0]))
+
+int main(void) {
+    volatile uint32_t sink = 0;
+
+    uint64_t start = host_time_ns();
+    for (int round = 0; round < LOOKUP_ROUNDS; round++) {
+        for (int state = 0; state < ALARM_STATE_COUNT; state++) {
+            for (int event = 0; event < ALARM_EVENT_COUNT; event++) {
+                sink += alarm_lookup_transition((alarm_state_t)state, (alarm_event_t)event) != NULL;
+            }
+        }
+    }
+    uint64_t lookup_ns = host_time_ns() - start;
+    uint64_t lookups = (uint64_t)LOOKUP_ROUNDS * ALARM_STATE_COUNT * ALARM_EVENT_COUNT;
+
+    alarm_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.current_state = ALARM_STATE_DISARMED;
+    start = host_time_ns();
+    for (int round = 0; round < UPDATE_ROUNDS; round++) {
+        update_alarm_state(&ctx, EVENT_TRIGGER);    // ignored while disarmed
+    }
+    uint64_t ignored_ns = host_time_ns() - start;
+
+    // Transitions log a line each, keep that off the terminal but in the measurement.
+    // Results go to stderr from here on.
+    fflush(stdout);
+    if (!freopen("/dev/null", "w", stdout)) return EXIT_FAILURE;
+    ctx.current_state = ALARM_STATE_ARMED;
+    start = host_time_ns();
+    for (int round = 0; round < UPDATE_ROUNDS; round++) {
+        host_fakes_reset();     // keep the fake change ring from filling up
+        for (size_t i = 0; i < CYCLE_LEN; i++) {
+            update_alarm_state(&ctx, cycle[i]);
+        }
+    }
+    uint64_t transition_ns = host_time_ns() - start;
+
+    fprintf(stderr, "alarm lookup:      %6.2f ns (%llu lookups, %u valid)\n",
+            (double)lookup_ns / lookups, (unsigned long long)lookups, sink);
+    fprintf(stderr, "ignored event:     %6.2f ns\n", (double)ignored_ns / UPDATE_ROUNDS);
+    fprintf(stderr, "transition:        %6.2f ns (includes the printf and the change event)\n",
+            (double)transition_ns / ((uint64_t)UPDATE_ROUNDS * CYCLE_LEN));
+    return ctx.current_state == ALARM_STATE_ARMED ? EXIT_SUCCESS : EXIT_FAILURE;
+}
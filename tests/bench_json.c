@@ -0,0 +1,95 @@
+// Payload encoding throughput: the streaming writer (JSON and CBOR) against the
+// snprintf formatting it replaced, for a door change and a status-sized document
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+#include "host_fakes.h"
+
+#define ROUNDS 2000000
+
+static char buf[640];
+static volatile uint32_t sink;
+
+static uint16_t door_writer(payload_format_t format, uint32_t i) {
+    json_writer_t w;
+    json_init(&w, buf, sizeof(buf));
+    json_set_format(&w, format);
+    json_object_begin(&w, NULL);
+    json_string(&w, "state", (i & 1) ? "open" : "closed");
+    json_uint(&w, "seq", i);
+    json_uint(&w, "timestamp", 1000000 + i);
+    json_object_end(&w);
+    return json_finish(&w);
+}
+
+static uint16_t door_snprintf(uint32_t i) {
+    int n = snprintf(buf, sizeof(buf), "{\"state\":\"%s\",\"seq\":%lu,\"timestamp\":%lu}",
+                     (i & 1) ? "open" : "closed", (unsigned long)i, (unsigned long)(1000000 + i));
+    return n > 0 && (size_t)n < sizeof(buf) ? (uint16_t)n : 0;
+}
+
+static uint16_t status_writer(payload_format_t format, uint32_t i) {
+    json_writer_t w;
+    json_init(&w, buf, sizeof(buf));
+    json_set_format(&w, format);
+    json_object_begin(&w, NULL);
+    json_string(&w, "status", "online");
+    json_uint(&w, "uptime_ms", 123456789 + i);
+    json_string(&w, "alarm_state", "ARMED");
+    json_bool(&w, "wifi_connected", true);
+    json_bool(&w, "mqtt_connected", true);
+    json_int(&w, "rssi", -61);
+    json_object_begin(&w, "journal");
+    json_uint(&w, "depth", i & 127);
+    json_uint(&w, "dropped", 0);
+    json_object_end(&w);
+    json_string(&w, "version", "1.0.0");
+    json_object_end(&w);
+    return json_finish(&w);
+}
+
+static uint16_t status_snprintf(uint32_t i) {
+    int n = snprintf(buf, sizeof(buf),
+                     "{\"status\":\"%s\",\"uptime_ms\":%lu,\"alarm_state\":\"%s\",\"wifi_connected\":%s,"
+                     "\"mqtt_connected\":%s,\"rssi\":%d,\"journal\":{\"depth\":%lu,\"dropped\":%lu},"
+                     "\"version\":\"%s\"}",
+                     "online", (unsigned long)(123456789 + i), "ARMED", "true", "true", -61,
+                     (unsigned long)(i & 127), 0ul, "1.0.0");
+    return n > 0 && (size_t)n < sizeof(buf) ? (uint16_t)n : 0;
+}
+
+typedef uint16_t (*writer_fn)(payload_format_t format, uint32_t i);
+typedef uint16_t (*printf_fn)(uint32_t i);
+
+static void report(const char *name, uint64_t ns, uint64_t bytes) {
+    printf("  %-14s %7.1f ns/doc %8.1f MB/s  %3llu B\n", name, (double)ns / ROUNDS,
+           (double)bytes * 1000.0 / (double)ns, (unsigned long long)(bytes / ROUNDS));
+}
+
+static void run(const char *doc, writer_fn writer, printf_fn formatted) {
+    printf("%s:\n", doc);
+
+    uint64_t bytes = 0;
+    uint64_t start = host_time_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) bytes += formatted(i);
+    report("snprintf", host_time_ns() - start, bytes);
+
+    bytes = 0;
+    start = host_time_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) bytes += writer(PAYLOAD_FORMAT_JSON, i);
+    report("writer json", host_time_ns() - start, bytes);
+
+    bytes = 0;
+    start = host_time_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) bytes += writer(PAYLOAD_FORMAT_CBOR, i);
+    report("writer cbor", host_time_ns() - start, bytes);
+    sink += (uint32_t)bytes;
+}
+
+int main(void) {
+    run("door change", door_writer, door_snprintf);
+    run("status", status_writer, status_snprintf);
+    return EXIT_SUCCESS;
+}
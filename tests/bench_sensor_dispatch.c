@@ -0,0 +1,113 @@
+// Interrupt dispatch cost at 8, 64 and 128 sensors: the original scan over every
+// sensor descriptor against the per-expander pin -> sensor table walked with ctz
+// that sensor_handle_interrupt() uses now. Both paths do the same per-sensor work
+// (record the edge time and the new level), only the lookup differs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sensor.h"
+#include "host_fakes.h"
+
+#define ROUNDS 2000000
+
+static sensor_config_t sensors[MAX_SENSORS];
+static sensor_expander_t expanders[MAX_EXPANDERS];
+static uint32_t edge_times[MAX_SENSORS];   // edge_us of sensor.c state
+static uint16_t levels[MAX_EXPANDERS];
+
+// Sensors fill expanders pin by pin, like the descriptor table in sensor.c
+static uint8_t build(uint32_t count) {
+    memset(sensors, 0, sizeof(sensors));
+    memset(expanders, 0, sizeof(expanders));
+    uint8_t expander_count = (uint8_t)((count + MCP23018_PIN_COUNT - 1) / MCP23018_PIN_COUNT);
+    for (uint8_t e = 0; e < expander_count; e++) {
+        memset(expanders[e].pin_sensor, SENSOR_NONE, sizeof(expanders[e].pin_sensor));
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        sensor_config_t *sensor = &sensors[i];
+        uint8_t pin = i % MCP23018_PIN_COUNT;
+        snprintf(sensor->name, sizeof(sensor->name), "sensor%u", (uint8_t)i);
+        sensor->expander = (uint8_t)(i / MCP23018_PIN_COUNT);
+        sensor->mcp_pin_mask = (uint16_t)(1u << pin);
+        sensor->active = true;
+        sensor->invert_logic = i & 1;
+
+        sensor_expander_t *expander = &expanders[sensor->expander];
+        if (expander->sensor_count++ == 0) expander->first_sensor = (uint8_t)i;
+        expander->pin_sensor[pin] = (uint8_t)i;
+        expander->sensor_mask |= sensor->mcp_pin_mask;
+        expander->active_mask |= sensor->mcp_pin_mask;
+        if (sensor->invert_logic) expander->invert_mask |= sensor->mcp_pin_mask;
+    }
+    return expander_count;
+}
+
+// Before: every descriptor is tested against the interrupt flags
+static void dispatch_scan(uint32_t count, uint8_t e, uint16_t intf, uint16_t intcap, uint32_t edge_us) {
+    for (uint32_t i = 0; i < count; i++) {
+        const sensor_config_t *sensor = &sensors[i];
+        if (!sensor->active || sensor->expander != e) continue;
+        if (intf & sensor->mcp_pin_mask) {
+            bool pin_state = (intcap & sensor->mcp_pin_mask) != 0;
+            bool sensor_state = sensor->invert_logic ? !pin_state : pin_state;
+            edge_times[i] = edge_us;
+            levels[e] ^= (uint16_t)(sensor_state << (i % MCP23018_PIN_COUNT));
+        }
+    }
+}
+
+// After: only the flagged pins, looked up through the expander's table
+static void dispatch_table(uint8_t e, uint16_t intf, uint16_t intcap, uint32_t edge_us) {
+    const sensor_expander_t *expander = &expanders[e];
+    uint16_t pending = intf & expander->active_mask;
+    uint16_t states = intcap ^ expander->invert_mask;
+    while (pending) {
+        uint8_t pin = (uint8_t)__builtin_ctz(pending);
+        pending &= pending - 1;
+        uint8_t i = expander->pin_sensor[pin];
+        edge_times[i] = edge_us;
+        levels[e] ^= (uint16_t)(((states >> pin) & 1) << pin);
+    }
+}
+
+static void run(uint32_t count, uint32_t changed_pins) {
+    uint8_t expander_count = build(count);
+    uint16_t pins_mask = count < MCP23018_PIN_COUNT ? (uint16_t)((1u << count) - 1) : 0xFFFF;
+
+    // Interrupts rotate over the expanders and pins; changed_pins adjacent pins per capture
+    uint64_t start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        uint8_t e = (uint8_t)(r % expander_count);
+        uint16_t intf = (uint16_t)(((1u << changed_pins) - 1) << (r % (MCP23018_PIN_COUNT - changed_pins + 1)));
+        dispatch_scan(count, e, intf & pins_mask, (uint16_t)r, r);
+    }
+    uint64_t scan_ns = host_time_ns() - start;
+
+    start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        uint8_t e = (uint8_t)(r % expander_count);
+        uint16_t intf = (uint16_t)(((1u << changed_pins) - 1) << (r % (MCP23018_PIN_COUNT - changed_pins + 1)));
+        dispatch_table(e, intf & pins_mask, (uint16_t)r, r);
+    }
+    uint64_t table_ns = host_time_ns() - start;
+
+    printf("  %3u sensors, %u changed: scan %7.1f ns  table %5.1f ns  (%.1fx)\n",
+           count, changed_pins, (double)scan_ns / ROUNDS, (double)table_ns / ROUNDS,
+           (double)scan_ns / (double)table_ns);
+}
+
+int main(void) {
+    static const uint32_t counts[] = { 8, 64, MAX_SENSORS };
+    printf("Interrupt dispatch per capture:\n");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        run(counts[i], 1);
+        run(counts[i], 4);
+    }
+    // Printed so the compiler cannot drop the dispatch work
+    uint32_t checksum = 0;
+    for (int e = 0; e < MAX_EXPANDERS; e++) checksum += levels[e];
+    for (int i = 0; i < MAX_SENSORS; i++) checksum += edge_times[i];
+    printf("  (checksum %lu)\n", (unsigned long)checksum);
+    return EXIT_SUCCESS;
+}
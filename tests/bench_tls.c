@@ -0,0 +1,279 @@
+// TLS handshake cost of the firmware's mbedtls profile, built once per profile as
+// bench_tls_default and bench_tls_lean. The client uses the device settings (2-way
+// auth, CA chain, SNI, tls_heap hooks). A broker stand-in runs in a forked child on
+// a local socket, so the client's CPU time, bytes on the wire and heap are its own.
+// Each round is a full handshake, then a reconnect resuming the saved session the
+// way mqtt.c does, with the broker issuing session tickets.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ticket.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/platform_time.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#include "tls_heap.h"
+#include "host_fakes.h"
+#include "tls/bench_certs.inc"
+
+#define HANDSHAKES 50
+
+// Firmware hooks the profiles expect (MBEDTLS_ENTROPY_HARDWARE_ALT, MBEDTLS_PLATFORM_MS_TIME_ALT)
+int mbedtls_hardware_poll(void *data, unsigned char *output, size_t len, size_t *olen) {
+    ssize_t n = getrandom(output, len, 0);
+    if (n < 0) return -1;
+    *olen = (size_t)n;
+    return 0;
+}
+
+mbedtls_ms_time_t mbedtls_ms_time(void) {
+    return (mbedtls_ms_time_t)(host_time_ns() / 1000000);
+}
+
+static uint64_t cpu_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Socket BIO that counts the handshake bytes in each direction
+typedef struct {
+    int fd;
+    uint32_t sent;
+    uint32_t received;
+} link_t;
+
+static int link_send(void *ctx, const unsigned char *buf, size_t len) {
+    link_t *link = ctx;
+    ssize_t n = write(link->fd, buf, len);
+    if (n < 0) return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+    link->sent += (uint32_t)n;
+    return (int)n;
+}
+
+static int link_recv(void *ctx, unsigned char *buf, size_t len) {
+    link_t *link = ctx;
+    ssize_t n = read(link->fd, buf, len);
+    if (n < 0) return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+    if (n == 0) return MBEDTLS_ERR_SSL_CONN_EOF;
+    link->received += (uint32_t)n;
+    return (int)n;
+}
+
+typedef struct {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt ca;
+    mbedtls_x509_crt cert;
+    mbedtls_pk_context key;
+    mbedtls_ssl_config conf;
+} endpoint_t;
+
+static void fail(const char *what, int ret) {
+    printf("%s failed: -0x%04x\n", what, (unsigned)-ret);
+    exit(1);
+}
+
+static void endpoint_init(endpoint_t *ep, int role, const char *cert, size_t cert_len,
+                          const char *key, size_t key_len) {
+    mbedtls_entropy_init(&ep->entropy);
+    mbedtls_ctr_drbg_init(&ep->drbg);
+    mbedtls_x509_crt_init(&ep->ca);
+    mbedtls_x509_crt_init(&ep->cert);
+    mbedtls_pk_init(&ep->key);
+    mbedtls_ssl_config_init(&ep->conf);
+
+    int ret = mbedtls_ctr_drbg_seed(&ep->drbg, mbedtls_entropy_func, &ep->entropy, NULL, 0);
+    if (ret) fail("ctr_drbg_seed", ret);
+    static const char ca_cert[] = TLS_ROOT_CERT;
+    ret = mbedtls_x509_crt_parse(&ep->ca, (const unsigned char *)ca_cert, sizeof(ca_cert));
+    if (ret) fail("ca parse", ret);
+    ret = mbedtls_x509_crt_parse(&ep->cert, (const unsigned char *)cert, cert_len);
+    if (ret) fail("cert parse", ret);
+    ret = mbedtls_pk_parse_key(&ep->key, (const unsigned char *)key, key_len, NULL, 0,
+                               mbedtls_ctr_drbg_random, &ep->drbg);
+    if (ret) fail("key parse", ret);
+
+    ret = mbedtls_ssl_config_defaults(&ep->conf, role, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret) fail("config_defaults", ret);
+    mbedtls_ssl_conf_rng(&ep->conf, mbedtls_ctr_drbg_random, &ep->drbg);
+    mbedtls_ssl_conf_authmode(&ep->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&ep->conf, &ep->ca, NULL);
+    ret = mbedtls_ssl_conf_own_cert(&ep->conf, &ep->cert, &ep->key);
+    if (ret) fail("own_cert", ret);
+}
+
+static int handshake(mbedtls_ssl_context *ssl) {
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(ssl)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) return ret;
+    }
+    return 0;
+}
+
+// Broker stand-in: accepts until the parent closes the socket or kills it
+static void run_broker(int listen_fd) {
+    static const char cert[] = TLS_SERVER_CERT;
+    static const char key[] = TLS_SERVER_KEY;
+    static endpoint_t broker;
+    static mbedtls_ssl_ticket_context tickets;
+    endpoint_init(&broker, MBEDTLS_SSL_IS_SERVER, cert, sizeof(cert), key, sizeof(key));
+
+    mbedtls_ssl_ticket_init(&tickets);
+    int ret = mbedtls_ssl_ticket_setup(&tickets, mbedtls_ctr_drbg_random, &broker.drbg,
+                                       MBEDTLS_CIPHER_AES_128_GCM, 86400);
+    if (ret) fail("ticket_setup", ret);
+    mbedtls_ssl_conf_session_tickets_cb(&broker.conf, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse,
+                                        &tickets);
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        link_t link = { .fd = fd };
+        mbedtls_ssl_context ssl;
+        mbedtls_ssl_init(&ssl);
+        if (mbedtls_ssl_setup(&ssl, &broker.conf) == 0) {
+            mbedtls_ssl_set_bio(&ssl, &link, link_send, link_recv, NULL);
+            if (handshake(&ssl) == 0) mbedtls_ssl_close_notify(&ssl);
+        }
+        mbedtls_ssl_free(&ssl);
+        close(fd);
+    }
+    exit(0);
+}
+
+typedef struct {
+    uint64_t cpu_ns;
+    uint64_t wall_ns;
+    uint64_t sent;
+    uint64_t received;
+    uint32_t heap_peak;
+    uint32_t count;
+} totals_t;
+
+static endpoint_t client;
+static uint32_t certs_verified;
+
+// Same resumption check as mqtt.c: a resumed handshake verifies no certificate
+static int count_verify(void *arg, mbedtls_x509_crt *crt, int depth, uint32_t *flags) {
+    certs_verified++;
+    return 0;
+}
+
+// Returns whether the handshake was resumed. Offers `session` if not NULL and
+// saves the new one into `save` if not NULL.
+static bool client_handshake(const struct sockaddr_un *addr, socklen_t addr_len,
+                             const mbedtls_ssl_session *session, mbedtls_ssl_session *save,
+                             totals_t *totals) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (const struct sockaddr *)addr, addr_len) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    link_t link = { .fd = fd };
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_init(&ssl);
+
+    // Same window as the firmware's connect statistics: mbedtls_ssl_setup() to handshake done
+    uint32_t base = tls_heap_in_use();
+    tls_heap_reset_peak();
+    uint64_t wall = host_time_ns();
+    uint64_t cpu = cpu_time_ns();
+
+    int ret = mbedtls_ssl_setup(&ssl, &client.conf);
+    if (ret) fail("ssl_setup", ret);
+    mbedtls_ssl_set_hostname(&ssl, "localhost");
+    mbedtls_ssl_set_verify(&ssl, count_verify, NULL);
+    certs_verified = 0;
+    if (session) {
+        ret = mbedtls_ssl_set_session(&ssl, session);
+        if (ret) fail("set_session", ret);
+    }
+    mbedtls_ssl_set_bio(&ssl, &link, link_send, link_recv, NULL);
+    ret = handshake(&ssl);
+    if (ret) fail("handshake", ret);
+
+    totals->cpu_ns += cpu_time_ns() - cpu;
+    totals->wall_ns += host_time_ns() - wall;
+    totals->sent += link.sent;
+    totals->received += link.received;
+    if (tls_heap_peak() - base > totals->heap_peak) totals->heap_peak = tls_heap_peak() - base;
+    totals->count++;
+
+    if (save) {
+        ret = mbedtls_ssl_get_session(&ssl, save);
+        if (ret) fail("get_session", ret);
+    }
+    mbedtls_ssl_close_notify(&ssl);
+    mbedtls_ssl_free(&ssl);
+    close(fd);
+    return session && certs_verified == 0;
+}
+
+static void report(const char *name, const totals_t *t) {
+    printf("  %-10s %7.2f ms cpu %7.2f ms wall  %5llu B sent %5llu B received  heap peak %6lu B\n",
+           name, (double)t->cpu_ns / t->count / 1e6, (double)t->wall_ns / t->count / 1e6,
+           (unsigned long long)(t->sent / t->count), (unsigned long long)(t->received / t->count),
+           (unsigned long)t->heap_peak);
+}
+
+int main(void) {
+    // Abstract socket name, nothing to clean up on the filesystem
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int name_len = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "sensor_hub_bench_tls_%d",
+                            (int)getpid());
+    socklen_t addr_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + name_len);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, addr_len) < 0 ||
+        listen(listen_fd, 4) < 0) {
+        perror("listen");
+        return 1;
+    }
+    pid_t broker = fork();
+    if (broker < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (broker == 0) run_broker(listen_fd);
+    close(listen_fd);
+
+    // Hooks first so the client's config allocations are counted like on the device
+    tls_heap_init();
+    static const char cert[] = TLS_CLIENT_CERT;
+    static const char key[] = TLS_CLIENT_KEY;
+    endpoint_init(&client, MBEDTLS_SSL_IS_CLIENT, cert, sizeof(cert), key, sizeof(key));
+
+    printf("TLS profile %s, %d handshakes, ECDSA P-256 chain, client auth\n", TLS_PROFILE, HANDSHAKES);
+    printf("  config   %6lu B heap (CA, client certificate and key)\n", (unsigned long)tls_heap_in_use());
+
+    totals_t full = {0};
+    totals_t resumed = {0};
+    uint32_t refused = 0;
+    for (int i = 0; i < HANDSHAKES; i++) {
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        client_handshake(&addr, addr_len, NULL, &session, &full);
+        if (!client_handshake(&addr, addr_len, &session, NULL, &resumed)) refused++;
+        mbedtls_ssl_session_free(&session);
+    }
+    report("full", &full);
+    report("resumed", &resumed);
+    if (refused) printf("  broker refused %lu of %d resumptions\n", (unsigned long)refused, HANDSHAKES);
+
+    kill(broker, SIGTERM);
+    waitpid(broker, NULL, 0);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Topic cost per publish and per inbound message: the snprintf formatting (plus the
+// copy into a 96-byte queue slot) that ran on every publish before, against the
+// interned pointers from topics.c. Inbound: rebuilding the cmd topic and strcmp
+// on every data fragment against one topics_match() per publish.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "mqtt.h"
+#include "topics.h"
+#include "sensor.h"
+#include "host_fakes.h"
+
+#define ROUNDS 2000000
+#define DOORS MAX_SENSORS
+#define FRAGMENTS 4     // data callbacks per inbound publish
+
+static sensor_config_t doors[DOORS];
+static char slot_topic[96];
+static volatile uint32_t sink;
+
+const sensor_config_t* sensor_get(uint8_t index) {
+    return index < DOORS ? &doors[index] : NULL;
+}
+
+// The bounded copy the old queue slots did, truncating at the slot size
+static void copy_to_slot(const char *topic) {
+    size_t len = strnlen(topic, sizeof(slot_topic) - 1);
+    memcpy(slot_topic, topic, len);
+    slot_topic[len] = '\0';
+}
+
+static void report(const char *name, uint64_t ns) {
+    printf("  %-28s %6.1f ns\n", name, (double)ns / ROUNDS);
+}
+
+int main(void) {
+    for (int i = 0; i < DOORS; i++) {
+        snprintf(doors[i].name, sizeof(doors[i].name), "Door %d", i);
+        snprintf(doors[i].computer_name, sizeof(doors[i].computer_name), "door_%d", i);
+        doors[i].type = SENSOR_TYPE_DOOR;
+        doors[i].active = true;
+    }
+    topics_init();
+
+    printf("Door publish topic:\n");
+    uint64_t start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        char topic[128];
+        const sensor_config_t *sensor = &doors[r % DOORS];
+        snprintf(topic, sizeof(topic), "%s/%s/door/%s/%s", SENSOR_ROOT_TOPIC, DEVICE_NAME,
+                 sensor->computer_name, (r & 1) ? "open" : "closed");
+        copy_to_slot(topic);
+        sink += (uint8_t)slot_topic[r % 16];
+    }
+    report("snprintf + slot copy", host_time_ns() - start);
+
+    start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        const char *topic = topics_door((uint8_t)(r % DOORS), r & 1);
+        sink += (uint8_t)topic[r % 16];
+    }
+    report("interned pointer", host_time_ns() - start);
+
+    printf("Alarm publish topic:\n");
+    start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        char topic[128];
+        snprintf(topic, sizeof(topic), "%s/%s/alarm/triggered", SENSOR_ROOT_TOPIC, DEVICE_NAME);
+        copy_to_slot(topic);
+        sink += (uint8_t)slot_topic[r % 16];
+    }
+    report("snprintf + slot copy", host_time_ns() - start);
+
+    start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        const char *topic = topics_get((topic_id_t)(TOPIC_ALARM_TRIGGERED + r % 3));
+        sink += (uint8_t)topic[r % 16];
+    }
+    report("interned pointer", host_time_ns() - start);
+
+    printf("Inbound command, %d fragments:\n", FRAGMENTS);
+    const char *inbound = MQTT_FULL_TOPIC_COMMAND;
+    start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        for (int f = 0; f < FRAGMENTS; f++) {
+            char cmd_topic[128];
+            snprintf(cmd_topic, sizeof(cmd_topic), "%s/%s/cmd", SENSOR_ROOT_TOPIC, DEVICE_NAME);
+            sink += strcmp(inbound, cmd_topic) == 0;
+        }
+    }
+    report("snprintf + strcmp per frag", host_time_ns() - start);
+
+    start = host_time_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        uint8_t topic_id = (uint8_t)topics_match(inbound);
+        for (int f = 0; f < FRAGMENTS; f++) {
+            sink += topic_id == TOPIC_COMMAND;
+        }
+    }
+    report("topics_match once", host_time_ns() - start);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include "host_fakes.h"
+#include <string.h>
+#include <time.h>
+#include "pico/time.h"
+#include "common.h"
+#include "sensor.h"
+
+host_fakes_t host_fakes;
+int host_failures = 0;
+
+// One ring per id, same semantics as events.c without the wake-up and latency stats
+static event_ring_t rings[EVENT_RING_COUNT];
+
+void host_fakes_reset(void) {
+    memset(&host_fakes, 0, sizeof(host_fakes));
+    for (int i = 0; i < EVENT_RING_COUNT; i++) {
+        event_ring_init(&rings[i]);
+    }
+}
+
+uint64_t host_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t time_us_64(void) {
+    return host_time_ns() / 1000;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            struct repeating_timer *out) {
+    out->delay_us = (int64_t)delay_ms * 1000;
+    out->callback = callback;
+    out->user_data = user_data;
+    host_fakes.timers_started++;
+    return true;
+}
+
+bool cancel_repeating_timer(struct repeating_timer *timer) {
+    host_fakes.timers_cancelled++;
+    return true;
+}
+
+bool events_push(event_ring_id_t ring, hub_event_t type, uint8_t pin, uint8_t level, uint32_t data) {
+    event_record_t record = {
+        .timestamp_us = time_us_64(),
+        .data = data,
+        .type = (uint8_t)type,
+        .pin = pin,
+        .level = level,
+    };
+    if (ring == EVENT_RING_SENSOR) {
+        host_fakes.sensor_pushes++;
+        host_fakes.last_sensor_push = record;
+    }
+    return event_ring_push(&rings[ring], &record);
+}
+
+bool events_push_shared(event_ring_id_t ring, hub_event_t type, uint8_t pin, uint8_t level, uint32_t data) {
+    return events_push(ring, type, pin, level, data);
+}
+
+bool events_pop(event_ring_id_t ring, event_record_t *event) {
+    return event_ring_pop(&rings[ring], event);
+}
+
+void events_mark_record_handled(const event_record_t *event) {
+    (void)event;
+}
+
+uint8_t sensor_index(const sensor_config_t *sensor) {
+    return sensor ? 0 : SENSOR_NONE;
+}
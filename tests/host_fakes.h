@@ -0,0 +1,38 @@
+#ifndef HOST_FAKES_H
+#define HOST_FAKES_H
+
+// Host replacements for the firmware functions the modules under test call
+// (events.c, sensor.c, pico-sdk timers). They record what was called so the
+// tests can check side effects.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "events.h"
+
+typedef struct {
+    uint32_t timers_started;
+    uint32_t timers_cancelled;
+    uint32_t sensor_pushes;             // events_push() calls on EVENT_RING_SENSOR
+    event_record_t last_sensor_push;
+} host_fakes_t;
+
+extern host_fakes_t host_fakes;
+
+void host_fakes_reset(void);
+
+// Monotonic host clock in ns, for benchmarks
+uint64_t host_time_ns(void);
+
+// Minimal check macro, the tests are plain executables run by ctest
+extern int host_failures;
+#define CHECK(cond, ...) do {                                           \
+        if (!(cond)) {                                                  \
+            printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__);                                        \
+            printf("\n");                                               \
+            host_failures++;                                            \
+        }                                                               \
+    } while (0)
+
+#endif // HOST_FAKES_H
@@ -0,0 +1,7 @@
+#ifndef HOST_HARDWARE_I2C_H
+#define HOST_HARDWARE_I2C_H
+
+// Only the types the sensor headers mention, nothing on the host talks to a bus
+typedef struct i2c_inst i2c_inst_t;
+
+#endif // HOST_HARDWARE_I2C_H
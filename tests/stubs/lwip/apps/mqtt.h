@@ -0,0 +1,35 @@
+#ifndef HOST_LWIP_APPS_MQTT_H
+#define HOST_LWIP_APPS_MQTT_H
+
+// Only the types common.h and mqtt.h mention, nothing on the host talks to a broker
+
+#include <stdint.h>
+
+#define MQTT_OUTPUT_RINGBUF_SIZE 1024
+
+typedef int8_t err_t;
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+typedef enum {
+    MQTT_CONNECT_ACCEPTED = 0,
+    MQTT_CONNECT_DISCONNECTED = 256,
+    MQTT_CONNECT_TIMEOUT = 257,
+} mqtt_connection_status_t;
+
+typedef struct mqtt_client_s mqtt_client_t;
+typedef struct { uint32_t addr; } ip_addr_t;
+
+struct mqtt_connect_client_info_t {
+    const char *client_id;
+    const char *client_user;
+    const char *client_pass;
+    uint16_t keep_alive;
+    const char *will_topic;
+    const char *will_msg;
+    uint8_t will_qos;
+    uint8_t will_retain;
+};
+
+#endif // HOST_LWIP_APPS_MQTT_H
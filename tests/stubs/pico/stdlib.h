@@ -0,0 +1,10 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/time.h"
+
+typedef unsigned int uint;
+
+#endif // HOST_PICO_STDLIB_H
@@ -0,0 +1,35 @@
+#ifndef HOST_PICO_TIME_H
+#define HOST_PICO_TIME_H
+
+// Host stand-in for the pico-sdk time API, implemented in host_fakes.c
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+
+struct repeating_timer;
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *rt);
+
+struct repeating_timer {
+    int64_t delay_us;
+    repeating_timer_callback_t callback;
+    void *user_data;
+};
+
+uint64_t time_us_64(void);
+
+static inline absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            struct repeating_timer *out);
+bool cancel_repeating_timer(struct repeating_timer *timer);
+
+#endif // HOST_PICO_TIME_H
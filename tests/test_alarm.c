@@ -0,0 +1,218 @@
+// Walks every (state, event) pair of the alarm transition table through
+// update_alarm_state() and checks the next state and the side effects.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alarm.h"
+#include "host_fakes.h"
+
+#define STAY (-1)
+
+// The intended behaviour, written out independently of alarm.c. STAY = event ignored.
+static const int expected[ALARM_STATE_COUNT][ALARM_EVENT_COUNT] = {
+    [ALARM_STATE_ARMED] = {
+        [EVENT_ARM] = STAY,
+        [EVENT_DISARM] = ALARM_STATE_DISARMED,
+        [EVENT_TIMEOUT] = STAY,
+        [EVENT_RESET] = STAY,
+        [EVENT_TRIGGER] = ALARM_STATE_TRIGGERED,
+        [EVENT_EXIT_DELAY] = STAY,
+        [EVENT_ENTRY_DELAY] = ALARM_STATE_TRIGGERING,
+        [EVENT_EXIT_DELAY_EXPIRED] = STAY,
+        [EVENT_ENTRY_DELAY_EXPIRED] = STAY,
+    },
+    [ALARM_STATE_ARMING] = {
+        [EVENT_ARM] = ALARM_STATE_ARMED,
+        [EVENT_DISARM] = ALARM_STATE_DISARMED,
+        [EVENT_TIMEOUT] = STAY,
+        [EVENT_RESET] = STAY,
+        [EVENT_TRIGGER] = STAY,
+        [EVENT_EXIT_DELAY] = STAY,
+        [EVENT_ENTRY_DELAY] = STAY,
+        [EVENT_EXIT_DELAY_EXPIRED] = ALARM_STATE_ARMED,
+        [EVENT_ENTRY_DELAY_EXPIRED] = STAY,
+    },
+    [ALARM_STATE_DISARMED] = {
+        [EVENT_ARM] = ALARM_STATE_ARMED,
+        [EVENT_DISARM] = STAY,
+        [EVENT_TIMEOUT] = STAY,
+        [EVENT_RESET] = STAY,
+        [EVENT_TRIGGER] = STAY,
+        [EVENT_EXIT_DELAY] = ALARM_STATE_ARMING,
+        [EVENT_ENTRY_DELAY] = STAY,
+        [EVENT_EXIT_DELAY_EXPIRED] = STAY,
+        [EVENT_ENTRY_DELAY_EXPIRED] = STAY,
+    },
+    [ALARM_STATE_TRIGGERED] = {
+        [EVENT_ARM] = STAY,
+        [EVENT_DISARM] = ALARM_STATE_DISARMED,
+        [EVENT_TIMEOUT] = ALARM_STATE_ARMED,
+        [EVENT_RESET] = ALARM_STATE_ARMED,
+        [EVENT_TRIGGER] = STAY,
+        [EVENT_EXIT_DELAY] = ALARM_STATE_DISARMED,
+        [EVENT_ENTRY_DELAY] = STAY,
+        [EVENT_EXIT_DELAY_EXPIRED] = STAY,
+        [EVENT_ENTRY_DELAY_EXPIRED] = STAY,
+    },
+    [ALARM_STATE_TRIGGERING] = {
+        [EVENT_ARM] = STAY,
+        [EVENT_DISARM] = ALARM_STATE_DISARMED,
+        [EVENT_TIMEOUT] = STAY,
+        [EVENT_RESET] = ALARM_STATE_ARMED,
+        [EVENT_TRIGGER] = ALARM_STATE_TRIGGERED,
+        [EVENT_EXIT_DELAY] = STAY,
+        [EVENT_ENTRY_DELAY] = STAY,
+        [EVENT_EXIT_DELAY_EXPIRED] = STAY,
+        [EVENT_ENTRY_DELAY_EXPIRED] = ALARM_STATE_TRIGGERED,
+    },
+};
+
+// States with a delay timer, entering starts it and leaving cancels it
+static bool has_timer(alarm_state_t state) {
+    return state == ALARM_STATE_ARMING || state == ALARM_STATE_TRIGGERING;
+}
+
+static void test_pair(alarm_state_t state, alarm_event_t event) {
+    const char *from = alarm_state_to_string(state);
+    int next = expected[state][event];
+
+    alarm_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.current_state = state;
+    // As if the state had been entered normally, so leaving it has a timer to cancel
+    ctx.exit_delay_active = state == ALARM_STATE_ARMING;
+    ctx.enter_delay_active = state == ALARM_STATE_TRIGGERING;
+    host_fakes_reset();
+
+    const alarm_transition_t *transition = alarm_lookup_transition(state, event);
+    CHECK((transition != NULL) == (next != STAY), "%s + event %d: lookup", from, event);
+    if (transition) {
+        CHECK(transition->next_state == next, "%s + event %d: lookup gives %d, want %d",
+              from, event, transition->next_state, next);
+    }
+
+    update_alarm_state(&ctx, event);
+
+    if (next == STAY) {
+        CHECK(ctx.current_state == state, "%s + event %d: moved to %s",
+              from, event, alarm_state_to_string(ctx.current_state));
+        CHECK(host_fakes.sensor_pushes == 0, "%s + event %d: ignored event published a change", from, event);
+        CHECK(host_fakes.timers_started == 0 && host_fakes.timers_cancelled == 0,
+              "%s + event %d: ignored event touched a timer", from, event);
+        return;
+    }
+
+    CHECK(ctx.current_state == (alarm_state_t)next, "%s + event %d: got %s, want %s", from, event,
+          alarm_state_to_string(ctx.current_state), alarm_state_to_string((alarm_state_t)next));
+
+    // Every real change is queued for publishing with the old and new state
+    CHECK(host_fakes.sensor_pushes == 1, "%s + event %d: %u change events", from, event,
+          host_fakes.sensor_pushes);
+    CHECK(host_fakes.last_sensor_push.type == HUB_EVENT_ALARM_CHANGED &&
+          host_fakes.last_sensor_push.pin == state &&
+          host_fakes.last_sensor_push.level == next,
+          "%s + event %d: wrong change record", from, event);
+
+    CHECK(host_fakes.timers_cancelled == (has_timer(state) ? 1u : 0u),
+          "%s + event %d: %u timers cancelled", from, event, host_fakes.timers_cancelled);
+    CHECK(host_fakes.timers_started == (has_timer((alarm_state_t)next) ? 1u : 0u),
+          "%s + event %d: %u timers started", from, event, host_fakes.timers_started);
+    CHECK(ctx.exit_delay_active == (next == ALARM_STATE_ARMING),
+          "%s + event %d: exit delay flag", from, event);
+    CHECK(ctx.enter_delay_active == (next == ALARM_STATE_TRIGGERING),
+          "%s + event %d: entry delay flag", from, event);
+    if (next == ALARM_STATE_TRIGGERED) {
+        CHECK(ctx.alarm_start_time == to_ms_since_boot(get_absolute_time()) ||
+              ctx.alarm_start_time + 1 == to_ms_since_boot(get_absolute_time()),
+              "%s + event %d: trigger time not recorded", from, event);
+    }
+}
+
+// The fake timers never fire on their own, this runs the callback like the timer IRQ
+static void fire(struct repeating_timer *timer) {
+    timer->callback(timer);
+}
+
+// Inputs go through the alarm ring and are applied in the order they were posted
+static void test_queued_order(void) {
+    alarm_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.current_state = ALARM_STATE_DISARMED;
+    host_fakes_reset();
+
+    CHECK(alarm_post_event(EVENT_EXIT_DELAY), "post");
+    CHECK(ctx.current_state == ALARM_STATE_DISARMED, "posting must not apply the event");
+    alarm_process_events(&ctx);
+    CHECK(ctx.current_state == ALARM_STATE_ARMING, "exit delay gave %s", alarm_state_to_string(ctx.current_state));
+
+    fire(&ctx.exit_timer);
+    CHECK(alarm_post_event(EVENT_ENTRY_DELAY), "post");
+    alarm_process_events(&ctx);
+    CHECK(ctx.current_state == ALARM_STATE_TRIGGERING, "expiry + entry delay gave %s",
+          alarm_state_to_string(ctx.current_state));
+
+    fire(&ctx.entry_timer);
+    alarm_process_events(&ctx);
+    CHECK(ctx.current_state == ALARM_STATE_TRIGGERED, "queued sequence ended in %s",
+          alarm_state_to_string(ctx.current_state));
+    CHECK(host_fakes.sensor_pushes == 4, "%u change events for 4 transitions", host_fakes.sensor_pushes);
+}
+
+// A timer that fires while the main loop handles the DISARM cannot be cancelled any
+// more. Its expiry lands behind the next EXIT_DELAY and must not end that delay early.
+static void test_stale_expiry(void) {
+    alarm_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.current_state = ALARM_STATE_DISARMED;
+    host_fakes_reset();
+
+    alarm_post_event(EVENT_EXIT_DELAY);
+    alarm_process_events(&ctx);
+    alarm_post_event(EVENT_DISARM);
+    alarm_process_events(&ctx);
+    alarm_post_event(EVENT_EXIT_DELAY);
+    fire(&ctx.exit_timer);                  // the old delay, queued behind EXIT_DELAY
+    alarm_process_events(&ctx);
+    CHECK(ctx.current_state == ALARM_STATE_ARMING, "stale exit expiry left %s",
+          alarm_state_to_string(ctx.current_state));
+
+    fire(&ctx.exit_timer);
+    alarm_process_events(&ctx);
+    CHECK(ctx.current_state == ALARM_STATE_ARMED, "current exit expiry left %s",
+          alarm_state_to_string(ctx.current_state));
+
+    alarm_post_event(EVENT_ENTRY_DELAY);
+    alarm_process_events(&ctx);
+    alarm_post_event(EVENT_RESET);
+    alarm_process_events(&ctx);
+    alarm_post_event(EVENT_ENTRY_DELAY);
+    fire(&ctx.entry_timer);
+    alarm_process_events(&ctx);
+    CHECK(ctx.current_state == ALARM_STATE_TRIGGERING, "stale entry expiry left %s",
+          alarm_state_to_string(ctx.current_state));
+    CHECK(host_fakes.sensor_pushes == 7, "%u change events for 7 transitions", host_fakes.sensor_pushes);
+}
+
+static void test_out_of_range(void) {
+    CHECK(alarm_lookup_transition(ALARM_STATE_COUNT, EVENT_ARM) == NULL, "state out of range");
+    CHECK(alarm_lookup_transition(ALARM_STATE_ARMED, ALARM_EVENT_COUNT) == NULL, "event out of range");
+    CHECK(alarm_lookup_transition((alarm_state_t)-1, EVENT_ARM) == NULL, "negative state");
+    CHECK(strcmp(alarm_state_to_string(ALARM_STATE_COUNT), "UNKNOWN") == 0, "state name out of range");
+}
+
+int main(void) {
+    int pairs = 0;
+    for (int state = 0; state < ALARM_STATE_COUNT; state++) {
+        for (int event = 0; event < ALARM_EVENT_COUNT; event++) {
+            test_pair((alarm_state_t)state, (alarm_event_t)event);
+            pairs++;
+        }
+    }
+    test_queued_order();
+    test_stale_expiry();
+    test_out_of_range();
+
+    printf("test_alarm: %d state/event pairs, %d failures\n", pairs, host_failures);
+    return host_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
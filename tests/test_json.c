@@ -0,0 +1,178 @@
+// Output, escaping, nesting and overflow behaviour of the streaming payload writer
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+#include "cbor.h"
+#include "host_fakes.h"
+
+#define GUARD 0xA5
+#define BUF_MAX 256
+
+static char buf[BUF_MAX + 16];
+
+static void expect_doc(json_writer_t *w, const char *want, const char *what) {
+    uint16_t len = json_finish(w);
+    CHECK(len == strlen(want) && strcmp(buf, want) == 0, "%s: got '%s' (%u), want '%s'",
+          what, len ? buf : "", len, want);
+}
+
+static void test_members(void) {
+    json_writer_t w;
+    json_init(&w, buf, BUF_MAX);
+    json_object_begin(&w, NULL);
+    json_string(&w, "state", "open");
+    json_uint(&w, "seq", 0);
+    json_uint(&w, "max", UINT32_MAX);
+    json_int(&w, "neg", -42);
+    json_int(&w, "min", INT32_MIN);
+    json_int(&w, "pos", 7);
+    json_bool(&w, "yes", true);
+    json_bool(&w, "no", false);
+    json_string(&w, "null", NULL);
+    json_object_end(&w);
+    expect_doc(&w, "{\"state\":\"open\",\"seq\":0,\"max\":4294967295,\"neg\":-42,"
+                   "\"min\":-2147483648,\"pos\":7,\"yes\":true,\"no\":false,\"null\":\"\"}", "members");
+
+    json_init(&w, buf, BUF_MAX);
+    json_object_begin(&w, NULL);
+    json_object_end(&w);
+    expect_doc(&w, "{}", "empty object");
+}
+
+static void test_escaping(void) {
+    static const struct {
+        const char *in;
+        const char *out;
+    } cases[] = {
+        { "plain", "\"plain\"" },
+        { "say \"hi\"", "\"say \\\"hi\\\"\"" },
+        { "back\\slash", "\"back\\\\slash\"" },
+        { "a\nb\rc\td", "\"a\\nb\\rc\\td\"" },
+        { "\x01\x1f", "\"\\u0001\\u001f\"" },
+        { "\x7f", "\"\x7f\"" },                        // DEL is legal JSON
+        { "caf\xc3\xa9", "\"caf\xc3\xa9\"" },          // UTF-8 passes through
+        { "/", "\"/\"" },
+        { "", "\"\"" },
+    };
+    char want[64];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        json_writer_t w;
+        json_init(&w, buf, BUF_MAX);
+        json_object_begin(&w, NULL);
+        json_string(&w, "v", cases[i].in);
+        json_object_end(&w);
+        snprintf(want, sizeof(want), "{\"v\":%s}", cases[i].out);
+        expect_doc(&w, want, "escaping");
+    }
+}
+
+static void test_nesting(void) {
+    json_writer_t w;
+    json_init(&w, buf, BUF_MAX);
+    json_object_begin(&w, NULL);
+    json_uint(&w, "a", 1);
+    json_object_begin(&w, "inner");
+    json_object_begin(&w, "deeper");
+    json_object_end(&w);
+    json_bool(&w, "b", true);
+    json_object_end(&w);
+    json_object_begin(&w, "second");
+    json_uint(&w, "c", 2);
+    json_object_end(&w);
+    json_uint(&w, "d", 3);
+    json_object_end(&w);
+    expect_doc(&w, "{\"a\":1,\"inner\":{\"deeper\":{},\"b\":true},\"second\":{\"c\":2},\"d\":3}", "nesting");
+}
+
+// A payload with every member type, the reference for the overflow sweep
+static void write_sample(json_writer_t *w) {
+    json_object_begin(w, NULL);
+    json_string(w, "triggered_by", "front \"door\"\n");
+    json_uint(w, "seq", 123456);
+    json_int(w, "rssi", -67);
+    json_object_begin(w, "link");
+    json_bool(w, "up", true);
+    json_object_end(w);
+    json_object_end(w);
+}
+
+// Every buffer size either holds the whole document or reports 0 with an empty
+// string, and nothing is written past the buffer
+static void test_overflow(payload_format_t format) {
+    json_writer_t w;
+    json_init(&w, buf, BUF_MAX);
+    json_set_format(&w, format);
+    write_sample(&w);
+    uint16_t full = json_finish(&w);
+    CHECK(full > 0, "format %d: sample does not fit %d bytes", format, BUF_MAX);
+    char reference[BUF_MAX];
+    memcpy(reference, buf, full);
+
+    for (size_t size = 0; size <= (size_t)full + 1; size++) {
+        memset(buf, GUARD, sizeof(buf));
+        json_init(&w, buf, size);
+        json_set_format(&w, format);
+        write_sample(&w);
+        uint16_t len = json_finish(&w);
+
+        if (size > full) {
+            CHECK(len == full && memcmp(buf, reference, full) == 0 && buf[full] == '\0',
+                  "format %d, size %zu: document damaged", format, size);
+        } else {
+            CHECK(len == 0 && w.overflow, "format %d, size %zu: overflow not reported", format, size);
+            CHECK(size == 0 || buf[0] == '\0', "format %d, size %zu: partial document left", format, size);
+        }
+        for (size_t i = size; i < sizeof(buf); i++) {
+            if ((unsigned char)buf[i] != GUARD) {
+                CHECK(false, "format %d, size %zu: wrote byte %zu", format, size, i);
+                break;
+            }
+        }
+    }
+}
+
+// Known members become integer keys, maps are indefinite-length
+static void test_cbor(void) {
+    json_writer_t w;
+    json_init(&w, buf, BUF_MAX);
+    json_set_format(&w, PAYLOAD_FORMAT_CBOR);
+    json_object_begin(&w, NULL);
+    json_uint(&w, "seq", 24);
+    json_int(&w, "x", -1);
+    json_bool(&w, "replayed", true);
+    json_object_end(&w);
+    uint16_t len = json_finish(&w);
+
+    uint8_t seq = cbor_key_id("seq");
+    uint8_t replayed = cbor_key_id("replayed");
+    CHECK(seq != 0 && seq < 24 && replayed != 0 && replayed < 24, "key table changed");
+    const uint8_t want[] = {
+        CBOR_MAP_BEGIN,
+        seq, 0x18, 24,              // uint with a one byte argument
+        0x61, 'x', 0x20,            // text key "x", negative int -1
+        replayed, CBOR_TRUE,
+        CBOR_BREAK,
+    };
+    CHECK(len == sizeof(want) && memcmp(buf, want, sizeof(want)) == 0, "cbor encoding (%u bytes)", len);
+
+    // The format is fixed once the document has started
+    json_init(&w, buf, BUF_MAX);
+    json_object_begin(&w, NULL);
+    json_set_format(&w, PAYLOAD_FORMAT_CBOR);
+    json_object_end(&w);
+    expect_doc(&w, "{}", "late format switch");
+}
+
+int main(void) {
+    test_members();
+    test_escaping();
+    test_nesting();
+    test_overflow(PAYLOAD_FORMAT_JSON);
+    test_overflow(PAYLOAD_FORMAT_CBOR);
+    test_cbor();
+
+    printf("test_json: %d failures\n", host_failures);
+    return host_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_TLS_CONFIG_H
+#define BENCH_TLS_CONFIG_H
+
+// The firmware's mbedtls profile (default or SENSOR_HUB_LEAN_TLS) plus the server
+// side, which bench_tls needs for its in-process broker, and the server's ticket
+// keys for resumption. The client half of the library is built exactly as on the device.
+#include "mbedtls_config.h"
+
+#define MBEDTLS_SSL_SRV_C
+#define MBEDTLS_SSL_TICKET_C
+
+#endif
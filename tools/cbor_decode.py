@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Decode sensor hub CBOR payloads to JSON.
+
+Door, alarm and heartbeat payloads are CBOR when the hub's retained
+sensor_hub/<device>/format flag says "cbor". Maps use small integer keys
+from the table below, which must match key_table in src/cbor.c.
+
+    mosquitto_sub -h broker -t 'sensor_hub/+/door/#' -C 1 -N | tools/cbor_decode.py
+    tools/cbor_decode.py --hex bf0164 6f70656e ...
+    tools/cbor_decode.py payload.bin
+
+JSON payloads are passed through unchanged, so mixed captures work too. Only a
+payload starting with a CBOR map head is decoded as CBOR; other short ASCII
+payloads, like the "0"/"1" online flag on the heartbeat topic, are printed as
+they are. --format overrides the detection.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+# Index + 1 is the key on the wire (src/cbor.c)
+KEYS = [
+    "state",
+    "seq",
+    "timestamp",
+    "replayed",
+    "triggered_by",
+    "status",
+    "uptime_ms",
+    "alarm_state",
+    "wifi_connected",
+    "mqtt_connected",
+    "version",
+]
+
+BREAK = object()
+
+
+class Decoder:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise ValueError("truncated payload")
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise ValueError("truncated payload")
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def argument(self, info):
+        if info < 24:
+            return info
+        if info == 24:
+            return self.byte()
+        if info == 25:
+            return struct.unpack(">H", self.take(2))[0]
+        if info == 26:
+            return struct.unpack(">I", self.take(4))[0]
+        if info == 27:
+            return struct.unpack(">Q", self.take(8))[0]
+        raise ValueError("unsupported additional info %d" % info)
+
+    def item(self):
+        initial = self.byte()
+        major, info = initial >> 5, initial & 0x1F
+
+        if initial == 0xFF:
+            return BREAK
+        if major == 0:
+            return self.argument(info)
+        if major == 1:
+            return -1 - self.argument(info)
+        if major in (2, 3):
+            raw = self.take(self.argument(info))
+            return raw.hex() if major == 2 else raw.decode("utf-8")
+        if major == 4:
+            return self.array(info)
+        if major == 5:
+            return self.map(info)
+        if major == 7:
+            simple = {20: False, 21: True, 22: None}
+            if info in simple:
+                return simple[info]
+        raise ValueError("unsupported item 0x%02x at offset %d" % (initial, self.pos - 1))
+
+    def array(self, info):
+        out = []
+        count = None if info == 31 else self.argument(info)
+        while count is None or len(out) < count:
+            value = self.item()
+            if value is BREAK:
+                break
+            out.append(value)
+        return out
+
+    def map(self, info):
+        out = {}
+        count = None if info == 31 else self.argument(info)
+        while count is None or len(out) < count:
+            key = self.item()
+            if key is BREAK:
+                break
+            if isinstance(key, int) and 0 < key <= len(KEYS):
+                key = KEYS[key - 1]
+            out[str(key)] = self.item()
+        return out
+
+
+FORMATS = ("auto", "json", "cbor", "text")
+
+
+class Text(str):
+    """A payload that is neither JSON nor CBOR, printed verbatim."""
+
+
+def detect(payload):
+    """Format of a payload: every hub CBOR payload is a map, so anything that
+    does not start with a map head is JSON or plain text."""
+    if payload[:1] == b"{":
+        return "json"
+    if payload[:1] and 0xA0 <= payload[0] <= 0xBF:
+        return "cbor"
+    if all(0x20 <= b < 0x7F or b in b"\t\r\n" for b in payload):
+        return "text"
+    return "cbor"
+
+
+def decode(payload, fmt="auto"):
+    """Returns the payload as a Python object, CBOR, JSON or Text."""
+    if fmt == "auto":
+        fmt = detect(payload)
+    if fmt == "json":
+        return json.loads(payload.decode("utf-8"))
+    if fmt == "text":
+        return Text(payload.decode("ascii", errors="replace"))
+    decoder = Decoder(payload)
+    value = decoder.item()
+    if decoder.pos != len(payload):
+        raise ValueError("%d trailing bytes" % (len(payload) - decoder.pos))
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("file", nargs="?", help="payload file (default: stdin)")
+    parser.add_argument("--hex", nargs="+", help="payload as hex digits instead of a file")
+    parser.add_argument("--format", choices=FORMATS, default="auto",
+                        help="payload format (default: detect from the first byte)")
+    args = parser.parse_args()
+
+    if args.hex:
+        payload = bytes.fromhex("".join(args.hex))
+    elif args.file:
+        with open(args.file, "rb") as f:
+            payload = f.read()
+    else:
+        payload = sys.stdin.buffer.read()
+
+    try:
+        value = decode(payload, args.format)
+    except ValueError as e:
+        print("cbor_decode: %s" % e, file=sys.stderr)
+        return 1
+
+    print(value if isinstance(value, Text) else json.dumps(value))
+    print("%d bytes" % len(payload), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())